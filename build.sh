@@ -6,7 +6,7 @@ CC="${CC:-cc}"
 PKGS="sdl2 glew freetype2"
 CFLAGS="-Wall -Wextra -std=c11 -pedantic -ggdb"
 LIBS=-lm
-SRC="src/main.c src/la.c src/editor.c src/file_browser.c src/free_glyph.c src/simple_renderer.c src/common.c src/lexer.c"
+SRC="src/main.c src/la.c src/editor.c src/file_browser.c src/free_glyph.c src/highlighter.c src/simple_renderer.c src/common.c src/lexer.c src/buffer.c src/lines.c src/project_search.c src/regex.c src/scan.c src/search.c src/tokens.c"
 
 if [ `uname` = "Darwin" ]; then
     CFLAGS+=" -framework OpenGL"
@@ -0,0 +1,36 @@
+#version 330 core
+
+uniform vec2 resolution;
+uniform float time;
+uniform float camera_scale;
+uniform vec2 camera_pos;
+
+// Filled in by free_glyph_atlas_init(), the size matches GLYPH_METRICS_CAPACITY
+layout(std140) uniform Glyphs {
+    vec4 glyphs_rects[128]; // bitmap_left, bitmap_top, width, -rows
+    vec4 glyphs_uvs[128];   // x, y, width, height in the atlas
+};
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in uint glyph;
+
+out vec4 out_color;
+out vec2 out_uv;
+
+vec2 camera_project(vec2 point)
+{
+    return 2.0 * (point - camera_pos) * camera_scale / resolution;
+}
+
+void main() {
+    // The corners 0-1-2 and 1-2-3 of the quad like simple_renderer_quad() does them
+    int corner = gl_VertexID < 3 ? gl_VertexID : gl_VertexID - 2;
+    vec2 unit = vec2(corner & 1, corner >> 1);
+
+    vec4 rect = glyphs_rects[glyph];
+    vec4 uv = glyphs_uvs[glyph];
+    gl_Position = vec4(camera_project(position + rect.xy + unit * rect.zw), 0, 1);
+    out_color = color;
+    out_uv = uv.xy + unit * uv.zw;
+}
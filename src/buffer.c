@@ -0,0 +1,348 @@
+#ifndef _WIN32
+// NOTE: for realpath(), mkstemp(), fchown() and fdopen(), which are POSIX and XSI, not C11
+#    define _XOPEN_SOURCE 700
+#endif // _WIN32
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "./buffer.h"
+
+#ifndef _WIN32
+#    include <sys/types.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif // _WIN32
+
+// Index of the piece that contains pos. Returns b->pieces.count if pos is at or past the end.
+static size_t buffer_find_piece(const Buffer *b, size_t pos)
+{
+    size_t lo = 0;
+    size_t hi = b->pieces.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        Piece p = b->pieces.items[mid];
+        if (pos < p.begin) {
+            hi = mid;
+        } else if (pos >= p.begin + p.count) {
+            lo = mid + 1;
+        } else {
+            return mid;
+        }
+    }
+    return lo;
+}
+
+// Replaces removed_count pieces starting at index with new_pieces and shifts
+// the pieces that follow by delta bytes.
+static void buffer_replace_pieces(Buffer *b, size_t index, size_t removed_count, const Piece *new_pieces, size_t new_pieces_count, ptrdiff_t delta)
+{
+    assert(index + removed_count <= b->pieces.count);
+    size_t count = b->pieces.count - removed_count + new_pieces_count;
+    if (count > b->pieces.capacity) {
+        if (b->pieces.capacity == 0) b->pieces.capacity = DA_INIT_CAP;
+        while (count > b->pieces.capacity) b->pieces.capacity *= 2;
+        b->pieces.items = realloc(b->pieces.items, b->pieces.capacity*sizeof(*b->pieces.items));
+        assert(b->pieces.items != NULL && "Buy more RAM lol");
+    }
+
+    if (removed_count != new_pieces_count) {
+        memmove(&b->pieces.items[index + new_pieces_count],
+                &b->pieces.items[index + removed_count],
+                (b->pieces.count - index - removed_count)*sizeof(*b->pieces.items));
+    }
+    if (new_pieces_count > 0) {
+        memcpy(&b->pieces.items[index], new_pieces, new_pieces_count*sizeof(*b->pieces.items));
+    }
+    b->pieces.count = count;
+
+    for (size_t i = index + new_pieces_count; i < b->pieces.count; ++i) {
+        b->pieces.items[i].begin += delta;
+    }
+}
+
+static const char *buffer_append_added(Buffer *b, const char *buf, size_t buf_len)
+{
+    Buffer_Block *block = b->added_end;
+    if (block == NULL || block->count + buf_len > block->capacity) {
+        size_t capacity = BUFFER_BLOCK_DEFAULT_CAPACITY;
+        if (capacity < buf_len) capacity = buf_len;
+        Buffer_Block *new_block = malloc(sizeof(Buffer_Block) + capacity);
+        assert(new_block != NULL && "Buy more RAM lol");
+        new_block->next = NULL;
+        new_block->count = 0;
+        new_block->capacity = capacity;
+        if (block == NULL) {
+            b->added_begin = new_block;
+        } else {
+            block->next = new_block;
+        }
+        b->added_end = new_block;
+        block = new_block;
+    }
+
+    char *result = &block->data[block->count];
+    memcpy(result, buf, buf_len);
+    block->count += buf_len;
+    return result;
+}
+
+void buffer_clear(Buffer *b)
+{
+    unmap_entire_file(b->original, b->original_size);
+    b->original = NULL;
+    b->original_size = 0;
+    b->original_dev = 0;
+    b->original_ino = 0;
+
+    Buffer_Block *block = b->added_begin;
+    while (block) {
+        Buffer_Block *next = block->next;
+        free(block);
+        block = next;
+    }
+    b->added_begin = NULL;
+    b->added_end = NULL;
+
+    b->pieces.count = 0;
+    b->count = 0;
+}
+
+char buffer_at(const Buffer *b, size_t pos)
+{
+    assert(pos < b->count);
+    Piece p = b->pieces.items[buffer_find_piece(b, pos)];
+    return p.data[pos - p.begin];
+}
+
+String_View buffer_chunk(const Buffer *b, size_t pos)
+{
+    if (pos >= b->count) return sv_from_parts(NULL, 0);
+    Piece p = b->pieces.items[buffer_find_piece(b, pos)];
+    return sv_from_parts(p.data + (pos - p.begin), p.count - (pos - p.begin));
+}
+
+String_View buffer_chunk_before(const Buffer *b, size_t pos)
+{
+    if (pos == 0 || pos > b->count) return sv_from_parts(NULL, 0);
+    Piece p = b->pieces.items[buffer_find_piece(b, pos - 1)];
+    return sv_from_parts(p.data, pos - p.begin);
+}
+
+void buffer_copy(const Buffer *b, size_t begin, size_t end, String_Builder *sb)
+{
+    if (end > b->count) end = b->count;
+    while (begin < end) {
+        String_View chunk = buffer_chunk(b, begin);
+        if (chunk.count > end - begin) chunk.count = end - begin;
+        sb_append_buf(sb, chunk.data, chunk.count);
+        begin += chunk.count;
+    }
+}
+
+void buffer_insert(Buffer *b, size_t pos, const char *buf, size_t buf_len)
+{
+    if (buf_len == 0) return;
+    if (pos > b->count) pos = b->count;
+
+    const char *data = buffer_append_added(b, buf, buf_len);
+    b->count += buf_len;
+
+    // Typing right after the previous insertion just extends its piece
+    if (pos > 0) {
+        size_t index = buffer_find_piece(b, pos - 1);
+        Piece *p = &b->pieces.items[index];
+        const Buffer_Block *block = b->added_end;
+        bool added = p->data >= block->data && p->data < block->data + block->capacity;
+        if (added && p->begin + p->count == pos && p->data + p->count == data) {
+            p->count += buf_len;
+            buffer_replace_pieces(b, index + 1, 0, NULL, 0, buf_len);
+            return;
+        }
+    }
+
+    Piece piece = {
+        .data = data,
+        .count = buf_len,
+        .begin = pos,
+    };
+
+    size_t index = buffer_find_piece(b, pos);
+    if (index < b->pieces.count && b->pieces.items[index].begin < pos) {
+        Piece p = b->pieces.items[index];
+        size_t left = pos - p.begin;
+        Piece split[3] = {
+            {.data = p.data, .count = left, .begin = p.begin},
+            piece,
+            {.data = p.data + left, .count = p.count - left, .begin = pos + buf_len},
+        };
+        buffer_replace_pieces(b, index, 1, split, 3, buf_len);
+    } else {
+        buffer_replace_pieces(b, index, 0, &piece, 1, buf_len);
+    }
+}
+
+void buffer_delete(Buffer *b, size_t pos, size_t len)
+{
+    if (pos >= b->count) return;
+    if (len > b->count - pos) len = b->count - pos;
+    if (len == 0) return;
+
+    size_t end = pos + len;
+    size_t first = buffer_find_piece(b, pos);
+    size_t last = buffer_find_piece(b, end - 1);
+    Piece head = b->pieces.items[first];
+    Piece tail = b->pieces.items[last];
+
+    Piece kept[2];
+    size_t kept_count = 0;
+    if (head.begin < pos) {
+        kept[kept_count++] = (Piece) {
+            .data = head.data,
+            .count = pos - head.begin,
+            .begin = head.begin,
+        };
+    }
+    size_t tail_end = tail.begin + tail.count;
+    if (end < tail_end) {
+        kept[kept_count++] = (Piece) {
+            .data = tail.data + (end - tail.begin),
+            .count = tail_end - end,
+            .begin = pos,
+        };
+    }
+
+    buffer_replace_pieces(b, first, last - first + 1, kept, kept_count, -(ptrdiff_t)len);
+    b->count -= len;
+}
+
+Errno buffer_load_from_file(Buffer *b, const char *file_path)
+{
+    const char *data = NULL;
+    size_t size = 0;
+    Errno err = map_entire_file(file_path, &data, &size);
+    if (err != 0) return err;
+
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+#ifndef _WIN32
+    struct stat st = {0};
+    if (stat(file_path, &st) < 0) {
+        err = errno;
+        unmap_entire_file(data, size);
+        return err;
+    }
+    dev = (uint64_t) st.st_dev;
+    ino = (uint64_t) st.st_ino;
+#endif // _WIN32
+
+    buffer_clear(b);
+    b->original = data;
+    b->original_size = size;
+    b->original_dev = dev;
+    b->original_ino = ino;
+    if (size > 0) {
+        Piece piece = {
+            .data = data,
+            .count = size,
+            .begin = 0,
+        };
+        da_append(&b->pieces, piece);
+    }
+    b->count = size;
+    return 0;
+}
+
+static Errno buffer_write(const Buffer *b, FILE *f)
+{
+    for (size_t i = 0; i < b->pieces.count; ++i) {
+        fwrite(b->pieces.items[i].data, 1, b->pieces.items[i].count, f);
+        if (ferror(f)) return errno;
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+// NOTE: the file the buffer has mapped can't be truncated and written in place, that would pull
+// the pages from under our feet. Instead the text goes into a new file next to it that is renamed
+// over it, and the mapping keeps the old contents alive. The new file gets the owner, the group
+// and the mode of the old one, and if that's not allowed the save fails instead. A symlink is
+// followed, so it's the file it points to that gets replaced. Other hard links to the old file
+// keep pointing at the old contents though.
+static Errno buffer_save_over_mapped(const Buffer *b, const char *file_path, const struct stat *st)
+{
+    Errno result = 0;
+    char *target = NULL;
+    String_Builder temp_path = {0};
+    int fd = -1;
+    FILE *f = NULL;
+
+    target = realpath(file_path, NULL);
+    if (target == NULL) return_defer(errno);
+
+    sb_append_cstr(&temp_path, target);
+    sb_append_cstr(&temp_path, ".ded~XXXXXX");
+    sb_append_null(&temp_path);
+    fd = mkstemp(temp_path.items);
+    if (fd < 0) {
+        // NOTE: nothing was created, so there is nothing to remove
+        temp_path.count = 0;
+        return_defer(errno);
+    }
+
+    if (fchown(fd, st->st_uid, st->st_gid) < 0) return_defer(errno);
+    if (fchmod(fd, st->st_mode & 07777) < 0) return_defer(errno);
+
+    f = fdopen(fd, "wb");
+    if (f == NULL) return_defer(errno);
+    fd = -1;
+
+    Errno err = buffer_write(b, f);
+    if (err != 0) return_defer(err);
+
+    int closed = fclose(f);
+    f = NULL;
+    if (closed != 0) return_defer(errno);
+
+    if (rename(temp_path.items, target) < 0) return_defer(errno);
+    temp_path.count = 0;
+
+defer:
+    if (f) fclose(f);
+    if (fd >= 0) close(fd);
+    if (temp_path.count > 0) remove(temp_path.items);
+    free(temp_path.items);
+    free(target);
+    return result;
+}
+#endif // _WIN32
+
+Errno buffer_save_to_file(const Buffer *b, const char *file_path)
+{
+#ifndef _WIN32
+    struct stat st = {0};
+    if (b->original != NULL && stat(file_path, &st) == 0
+            && (uint64_t) st.st_dev == b->original_dev && (uint64_t) st.st_ino == b->original_ino) {
+        return buffer_save_over_mapped(b, file_path, &st);
+    }
+#endif // _WIN32
+
+    Errno result = 0;
+    FILE *f = NULL;
+
+    f = fopen(file_path, "wb");
+    if (f == NULL) return_defer(errno);
+
+    Errno err = buffer_write(b, f);
+    if (err != 0) return_defer(err);
+
+    int closed = fclose(f);
+    f = NULL;
+    if (closed != 0) return_defer(errno);
+
+defer:
+    if (f) fclose(f);
+    return result;
+}
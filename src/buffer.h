@@ -0,0 +1,69 @@
+#ifndef BUFFER_H_
+#define BUFFER_H_
+
+#include <stdlib.h>
+#include "./common.h"
+#include "./sv.h"
+
+// A contiguous run of the text. Points either into the original file or into the added blocks.
+typedef struct {
+    const char *data;
+    size_t count;
+    size_t begin; // offset of the piece within the text
+} Piece;
+
+typedef struct {
+    Piece *items;
+    size_t count;
+    size_t capacity;
+} Pieces;
+
+// Append-only storage for the inserted text. Blocks are never moved or
+// reallocated, so the pieces can point straight into them.
+typedef struct Buffer_Block Buffer_Block;
+
+struct Buffer_Block {
+    Buffer_Block *next;
+    size_t count;
+    size_t capacity;
+    char data[];
+};
+
+#define BUFFER_BLOCK_DEFAULT_CAPACITY (64*1024)
+
+// Piece table. The original file is memory mapped read-only and is never
+// copied, so opening a file costs only the pages that are actually viewed
+// or searched, and the edited state costs memory proportional to the edits.
+typedef struct {
+    const char *original;
+    size_t original_size;
+    // Which file on disk is mapped, see buffer_save_to_file()
+    uint64_t original_dev;
+    uint64_t original_ino;
+
+    Buffer_Block *added_begin;
+    Buffer_Block *added_end;
+
+    Pieces pieces;
+    size_t count;
+} Buffer;
+
+void buffer_clear(Buffer *b);
+char buffer_at(const Buffer *b, size_t pos);
+// The longest contiguous run of bytes starting at pos.
+// Iterate the whole buffer with:
+//     for (size_t pos = 0; pos < b->count; pos += chunk.count) chunk = buffer_chunk(b, pos);
+String_View buffer_chunk(const Buffer *b, size_t pos);
+// The longest contiguous run of bytes that ends at pos, for going through the buffer backwards.
+String_View buffer_chunk_before(const Buffer *b, size_t pos);
+// Appends bytes [begin, end) to sb. The range is clamped to the buffer.
+void buffer_copy(const Buffer *b, size_t begin, size_t end, String_Builder *sb);
+void buffer_insert(Buffer *b, size_t pos, const char *buf, size_t buf_len);
+void buffer_delete(Buffer *b, size_t pos, size_t len);
+
+Errno buffer_load_from_file(Buffer *b, const char *file_path);
+// Writes the text over the file in place. If the file is the one the buffer has mapped, it is
+// written next to it and renamed over it instead, see buffer_save_to_file() for the details.
+Errno buffer_save_to_file(const Buffer *b, const char *file_path);
+
+#endif // BUFFER_H_
@@ -10,6 +10,8 @@
 #    include <dirent.h>
 #    include <sys/types.h>
 #    include <sys/stat.h>
+#    include <sys/mman.h>
+#    include <fcntl.h>
 #    include <unistd.h>
 #endif // _WIN32
 
@@ -130,6 +132,53 @@ defer:
     return result;
 }
 
+Errno map_entire_file(const char *file_path, const char **data, size_t *size)
+{
+#ifdef _WIN32
+    String_Builder sb = {0};
+    Errno err = read_entire_file(file_path, &sb);
+    if (err != 0) {
+        free(sb.items);
+        return err;
+    }
+    *data = sb.items;
+    *size = sb.count;
+    return 0;
+#else
+    Errno result = 0;
+    int fd = -1;
+
+    fd = open(file_path, O_RDONLY);
+    if (fd < 0) return_defer(errno);
+
+    struct stat sb = {0};
+    if (fstat(fd, &sb) < 0) return_defer(errno);
+
+    *data = NULL;
+    *size = (size_t) sb.st_size;
+    if (*size == 0) return_defer(0);
+
+    void *mapped = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) return_defer(errno);
+    *data = mapped;
+
+defer:
+    if (fd >= 0) close(fd);
+    return result;
+#endif // _WIN32
+}
+
+void unmap_entire_file(const char *data, size_t size)
+{
+    if (data == NULL) return;
+#ifdef _WIN32
+    UNUSED(size);
+    free((char *) data);
+#else
+    munmap((void *) data, size);
+#endif // _WIN32
+}
+
 Vec4f hex_to_vec4f(uint32_t color)
 {
     Vec4f result;
@@ -53,6 +53,20 @@ typedef int Errno;
         (da)->items[(da)->count++] = (item);                                         \
     } while (0)
 
+#define da_reserve(da, desired_capacity)                                             \
+    do {                                                                             \
+        if ((desired_capacity) > (da)->capacity) {                                   \
+            if ((da)->capacity == 0) {                                               \
+                (da)->capacity = DA_INIT_CAP;                                        \
+            }                                                                        \
+            while ((desired_capacity) > (da)->capacity) {                            \
+                (da)->capacity *= 2;                                                 \
+            }                                                                        \
+            (da)->items = realloc((da)->items, (da)->capacity*sizeof(*(da)->items)); \
+            assert((da)->items != NULL && "Buy more RAM lol");                       \
+        }                                                                            \
+    } while (0)
+
 #define da_append_many(da, new_items, new_items_count)                                      \
     do {                                                                                    \
         if ((da)->count + new_items_count > (da)->capacity) {                               \
@@ -111,6 +125,11 @@ typedef struct {
 
 Errno type_of_file(const char *file_path, File_Type *ft);
 Errno read_entire_file(const char *file_path, String_Builder *sb);
+// Maps the file read-only into memory. Pages are only read from the disk when they are touched.
+// On Windows the file is read with read_entire_file() instead. A file can't be truncated or
+// replaced there while it is mapped, so the editor could not save over the file it has open.
+Errno map_entire_file(const char *file_path, const char **data, size_t *size);
+void unmap_entire_file(const char *data, size_t size);
 Errno write_entire_file(const char *file_path, const char *buf, size_t buf_size);
 Errno read_entire_dir(const char *dir_path, Files *files);
 
@@ -2,18 +2,43 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <errno.h>
+#include <float.h>
 #include <string.h>
 #include "./editor.h"
 #include "./common.h"
 #include "la.h"
 
-void editor_delete_once(Editor *e);
+static void editor_will_edit(Editor *e, size_t pos, size_t removed);
+static void editor_edited(Editor *e, size_t pos, size_t removed, size_t inserted);
+static void editor_flush_edits(Editor *e);
+static void editor_syntax_highlight(Editor *e);
+static void editor_finish_indexing(Editor *e);
+static void editor_searcher(Editor *e, Searcher *s);
+static void editor_measure_range(const Editor *e, Free_Glyph_Atlas *atlas, size_t begin, size_t end, Vec2f *pos, float right);
+
+void editor_delete_range(Editor *e, size_t begin, size_t end)
+{
+    if (e->searching) return;
+
+    if (end > e->data.count) end = e->data.count;
+    if (begin >= end) return;
+
+    editor_will_edit(e, begin, end - begin);
+    buffer_delete(&e->data, begin, end - begin);
+    if (e->cursor >= end) {
+        e->cursor -= end - begin;
+    } else if (e->cursor > begin) {
+        e->cursor = begin;
+    }
+    editor_edited(e, begin, end - begin, 0);
+}
 
 void editor_backspace_once(Editor *e)
 {
     if (e->searching) {
         if (e->search.count > 0) {
             e->search.count -= 1;
+            e->search_matches_valid = false;
         }
     } else {
         if (e->cursor > e->data.count) {
@@ -21,39 +46,28 @@ void editor_backspace_once(Editor *e)
         }
         if (e->cursor == 0) return;
 
-        memmove(
-            &e->data.items[e->cursor - 1],
-            &e->data.items[e->cursor],
-            e->data.count - e->cursor
-        );
-        e->cursor -= 1;
-        e->data.count -= 1;
+        editor_delete_range(e, e->cursor - 1, e->cursor);
     }
 }
 
 void editor_backspace_word(Editor *e)
 {
-    while (e->cursor > 0 && !isalnum(e->data.items[e->cursor - 1])) {
-        editor_backspace_once(e);
+    size_t begin = e->cursor;
+    while (begin > 0 && !isalnum(buffer_at(&e->data, begin - 1))) {
+        begin -= 1;
     }
-    while (e->cursor > 0 && isalnum(e->data.items[e->cursor - 1])) {
-        editor_backspace_once(e);
+    while (begin > 0 && isalnum(buffer_at(&e->data, begin - 1))) {
+        begin -= 1;
     }
+    editor_delete_range(e, begin, e->cursor);
 }
 
 void editor_backspace_selection(Editor *e)
 {
     size_t begin = e->select_begin;
     size_t end = e->cursor;
-    if (begin < end) {
-        for (size_t i = begin; i < end; i++) {
-            editor_backspace_once(e);
-        }
-    } else {
-        for (size_t i = end; i < begin; i++) {
-            editor_delete_once(e);
-        }
-    }
+    if (begin > end) SWAP(size_t, begin, end);
+    editor_delete_range(e, begin, end);
     e->selection = false;
 }
 
@@ -61,52 +75,41 @@ void editor_backspace(Editor *e, bool control)
 {
     if (e->selection) {
         editor_backspace_selection(e);
-        editor_retokenize(e);
         return;
     }
 
     if (control) {
         editor_backspace_word(e);
-        editor_retokenize(e);
         return;
     }
 
     editor_backspace_once(e);
-    editor_retokenize(e);
 }
 
 void editor_delete_once(Editor *e)
 {
-    if (e->searching) return;
-
-    if (e->cursor >= e->data.count) return;
-    memmove(
-        &e->data.items[e->cursor],
-        &e->data.items[e->cursor + 1],
-        e->data.count - e->cursor - 1
-    );
-    e->data.count -= 1;
+    editor_delete_range(e, e->cursor, e->cursor + 1);
 }
 
 void editor_delete_word(Editor *e)
 {
-    while (e->cursor < e->data.count && !isalnum(e->data.items[e->cursor])) {
-        editor_delete_once(e);
+    size_t end = e->cursor;
+    while (end < e->data.count && !isalnum(buffer_at(&e->data, end))) {
+        end += 1;
     }
-    while (e->cursor < e->data.count && isalnum(e->data.items[e->cursor])) {
-        editor_delete_once(e);
+    while (end < e->data.count && isalnum(buffer_at(&e->data, end))) {
+        end += 1;
     }
+    editor_delete_range(e, e->cursor, end);
 }
 
 void editor_delete(Editor *e, bool control)
 {
     if (control) {
         editor_delete_word(e);
-        editor_retokenize(e);
         return;
     }
     editor_delete_once(e);
-    editor_retokenize(e);
 }
 
 // TODO: make sure that you always have new line at the end of the file while saving
@@ -115,8 +118,13 @@ void editor_delete(Editor *e, bool control)
 Errno editor_save_as(Editor *e, const char *file_path)
 {
     printf("Saving as %s...\n", file_path);
-    Errno err = write_entire_file(file_path, e->data.items, e->data.count);
+    Errno err = buffer_save_to_file(&e->data, file_path);
     if (err != 0) return err;
+    const Language *language = language_by_path(file_path);
+    if (e->language != language) {
+        e->language = language;
+        editor_syntax_highlight(e);
+    }
     e->file_path.count = 0;
     sb_append_cstr(&e->file_path, file_path);
     sb_append_null(&e->file_path);
@@ -127,20 +135,29 @@ Errno editor_save(const Editor *e)
 {
     assert(e->file_path.count > 0);
     printf("Saving as %s...\n", e->file_path.items);
-    return write_entire_file(e->file_path.items, e->data.items, e->data.count);
+    return buffer_save_to_file(&e->data, e->file_path.items);
 }
 
 Errno editor_load_from_file(Editor *e, const char *file_path)
 {
     printf("Loading %s\n", file_path);
 
-    e->data.count = 0;
-    Errno err = read_entire_file(file_path, &e->data);
+    // NOTE: the indexer and the highlighter may still be reading the file that is about to be unmapped
+    lines_index_finish(&e->lines);
+    highlighter_cancel(&e->highlighter);
+    highlighter_finish(&e->highlighter);
+
+    Errno err = buffer_load_from_file(&e->data, file_path);
     if (err != 0) return err;
 
     e->cursor = 0;
+    e->cursor_cache.valid = false;
+    e->dirty = false;
+    e->search_matches_valid = false;
+    e->language = language_by_path(file_path);
 
-    editor_retokenize(e);
+    lines_index_start(&e->lines, &e->data);
+    editor_syntax_highlight(e);
 
     e->file_path.count = 0;
     sb_append_cstr(&e->file_path, file_path);
@@ -149,48 +166,106 @@ Errno editor_load_from_file(Editor *e, const char *file_path)
     return 0;
 }
 
-size_t editor_cursor_row(const Editor *e)
+// The cursor cache brought up to date with e->cursor
+static Cursor_Cache *editor_cursor(Editor *e)
 {
-    assert(e->lines.count > 0);
-    for (size_t row = 0; row < e->lines.count; ++row) {
-        Line line = e->lines.items[row];
-        if (line.begin <= e->cursor && e->cursor <= line.end) {
-            return row;
-        }
+    editor_flush_edits(e);
+    Cursor_Cache *cc = &e->cursor_cache;
+    if (e->cursor > e->data.count) e->cursor = e->data.count;
+    if (!cc->valid || cc->pos != e->cursor) {
+        cc->row = lines_row_of(&e->lines, e->cursor);
+        cc->col = e->cursor - lines_at(&e->lines, cc->row).begin;
+        cc->preferred_col = cc->col;
+        cc->pos = e->cursor;
+        cc->x_valid = false;
+        cc->valid = true;
+    }
+    return cc;
+}
+
+static void editor_cursor_set(Editor *e, size_t row, size_t line_begin, size_t col)
+{
+    Cursor_Cache *cc = &e->cursor_cache;
+    e->cursor = line_begin + col;
+    cc->valid = true;
+    cc->pos = e->cursor;
+    cc->row = row;
+    cc->col = col;
+    cc->preferred_col = col;
+    cc->x_valid = col == 0;
+    cc->x = 0.0f;
+}
+
+static float editor_glyph_advance(const Editor *e, char x)
+{
+    Vec2f pos = vec2fs(0.0f);
+    free_glyph_atlas_measure_line_sized(e->atlas, &x, 1, &pos);
+    return pos.x;
+}
+
+static void editor_cursor_left(Editor *e)
+{
+    Cursor_Cache *cc = editor_cursor(e);
+    if (e->cursor == 0) return;
+    e->cursor -= 1;
+    char x = buffer_at(&e->data, e->cursor);
+    if (x == '\n') {
+        // Crossing a line is rare enough to just look the cursor up
+        cc->valid = false;
+        return;
+    }
+    cc->pos = e->cursor;
+    cc->col -= 1;
+    cc->preferred_col = cc->col;
+    if (cc->x_valid) cc->x -= editor_glyph_advance(e, x);
+}
+
+static void editor_cursor_right(Editor *e)
+{
+    Cursor_Cache *cc = editor_cursor(e);
+    if (e->cursor >= e->data.count) return;
+    char x = buffer_at(&e->data, e->cursor);
+    e->cursor += 1;
+    if (x == '\n') {
+        cc->valid = false;
+        return;
     }
-    return e->lines.count - 1;
+    cc->pos = e->cursor;
+    cc->col += 1;
+    cc->preferred_col = cc->col;
+    if (cc->x_valid) cc->x += editor_glyph_advance(e, x);
+}
+
+size_t editor_cursor_row(Editor *e)
+{
+    return editor_cursor(e)->row;
+}
+
+void editor_move_to_line(Editor *e, size_t row)
+{
+    size_t preferred_col = editor_cursor(e)->preferred_col;
+    if (row >= e->lines.count) row = e->lines.count - 1;
+    Line line = lines_at(&e->lines, row);
+    size_t col = preferred_col;
+    if (col > line.end - line.begin) col = line.end - line.begin;
+    editor_cursor_set(e, row, line.begin, col);
+    e->cursor_cache.preferred_col = preferred_col;
 }
 
 void editor_move_page_up(Editor *e)
 {
     editor_stop_search(e);
 
-    for (size_t i = 0; i < 10; i++) {
-        size_t cursor_row = editor_cursor_row(e);
-        size_t cursor_col = e->cursor - e->lines.items[cursor_row].begin;
-        if (cursor_row > 0) {
-            Line next_line = e->lines.items[cursor_row - 1];
-            size_t next_line_size = next_line.end - next_line.begin;
-            if (cursor_col > next_line_size) cursor_col = next_line_size;
-            e->cursor = next_line.begin + cursor_col;
-        }
-    }
+    size_t cursor_row = editor_cursor_row(e);
+    editor_move_to_line(e, cursor_row > 10 ? cursor_row - 10 : 0);
 }
 
 void editor_move_page_down(Editor *e)
 {
     editor_stop_search(e);
 
-    for (size_t i = 0; i < 10; i++) {
-        size_t cursor_row = editor_cursor_row(e);
-        size_t cursor_col = e->cursor - e->lines.items[cursor_row].begin;
-        if (cursor_row < e->lines.count - 1) {
-            Line next_line = e->lines.items[cursor_row + 1];
-            size_t next_line_size = next_line.end - next_line.begin;
-            if (cursor_col > next_line_size) cursor_col = next_line_size;
-            e->cursor = next_line.begin + cursor_col;
-        }
-    }
+    size_t cursor_row = editor_cursor_row(e);
+    editor_move_to_line(e, cursor_row + 10);
 }
 
 void editor_move_line_up(Editor *e)
@@ -198,12 +273,8 @@ void editor_move_line_up(Editor *e)
     editor_stop_search(e);
 
     size_t cursor_row = editor_cursor_row(e);
-    size_t cursor_col = e->cursor - e->lines.items[cursor_row].begin;
     if (cursor_row > 0) {
-        Line next_line = e->lines.items[cursor_row - 1];
-        size_t next_line_size = next_line.end - next_line.begin;
-        if (cursor_col > next_line_size) cursor_col = next_line_size;
-        e->cursor = next_line.begin + cursor_col;
+        editor_move_to_line(e, cursor_row - 1);
     }
 }
 
@@ -212,46 +283,42 @@ void editor_move_line_down(Editor *e)
     editor_stop_search(e);
 
     size_t cursor_row = editor_cursor_row(e);
-    size_t cursor_col = e->cursor - e->lines.items[cursor_row].begin;
     if (cursor_row < e->lines.count - 1) {
-        Line next_line = e->lines.items[cursor_row + 1];
-        size_t next_line_size = next_line.end - next_line.begin;
-        if (cursor_col > next_line_size) cursor_col = next_line_size;
-        e->cursor = next_line.begin + cursor_col;
+        editor_move_to_line(e, cursor_row + 1);
     }
 }
 
 void editor_move_char_left(Editor *e)
 {
     editor_stop_search(e);
-    if (e->cursor > 0) e->cursor -= 1;
+    editor_cursor_left(e);
 }
 
 void editor_move_char_right(Editor *e)
 {
     editor_stop_search(e);
-    if (e->cursor < e->data.count) e->cursor += 1;
+    editor_cursor_right(e);
 }
 
 void editor_move_word_left(Editor *e)
 {
     editor_stop_search(e);
-    while (e->cursor > 0 && !isalnum(e->data.items[e->cursor - 1])) {
-        e->cursor -= 1;
+    while (e->cursor > 0 && !isalnum(buffer_at(&e->data, e->cursor - 1))) {
+        editor_cursor_left(e);
     }
-    while (e->cursor > 0 && isalnum(e->data.items[e->cursor - 1])) {
-        e->cursor -= 1;
+    while (e->cursor > 0 && isalnum(buffer_at(&e->data, e->cursor - 1))) {
+        editor_cursor_left(e);
     }
 }
 
 void editor_move_word_right(Editor *e)
 {
     editor_stop_search(e);
-    while (e->cursor < e->data.count && !isalnum(e->data.items[e->cursor])) {
-        e->cursor += 1;
+    while (e->cursor < e->data.count && !isalnum(buffer_at(&e->data, e->cursor))) {
+        editor_cursor_right(e);
     }
-    while (e->cursor < e->data.count && isalnum(e->data.items[e->cursor])) {
-        e->cursor += 1;
+    while (e->cursor < e->data.count && isalnum(buffer_at(&e->data, e->cursor))) {
+        editor_cursor_right(e);
     }
 }
 
@@ -264,79 +331,373 @@ void editor_insert_buf(Editor *e, char *buf, size_t buf_len)
 {
     if (e->searching) {
         sb_append_buf(&e->search, buf, buf_len);
-        bool matched = false;
-        for (size_t pos = e->cursor; pos < e->data.count; ++pos) {
-            if (editor_search_matches_at(e, pos)) {
-                e->cursor = pos;
-                matched = true;
-                break;
-            }
+        // NOTE: a longer search only matches where the shorter one did, except for whole words and regexes.
+        // Too many matches to record are found again, the first ones would narrow down to few.
+        if (e->search_matches_valid && e->search_matches.end == e->data.count && !e->search_whole_word && !e->search_regex) {
+            Searcher s;
+            editor_searcher(e, &s);
+            matches_narrow(&e->search_matches, &s, &e->data);
+        } else {
+            e->search_matches_valid = false;
+        }
+        // NOTE: a regex that matches nothing may be on its way to one that does, like x{ to x{2}
+        if (!editor_search_next(e, e->cursor) && !e->search_regex) {
+            e->search.count -= buf_len;
+            e->search_matches_valid = false;
         }
-        if (!matched) e->search.count -= buf_len;
     } else {
         if (e->cursor > e->data.count) {
             e->cursor = e->data.count;
         }
 
-        for (size_t i = 0; i < buf_len; ++i) {
-            da_append(&e->data, '\0');
-        }
-        memmove(
-            &e->data.items[e->cursor + buf_len],
-            &e->data.items[e->cursor],
-            e->data.count - e->cursor - buf_len
-        );
-        memcpy(&e->data.items[e->cursor], buf, buf_len);
+        editor_will_edit(e, e->cursor, 0);
+        buffer_insert(&e->data, e->cursor, buf, buf_len);
+        editor_edited(e, e->cursor, 0, buf_len);
         e->cursor += buf_len;
-        editor_retokenize(e);
     }
 }
 
-void editor_retokenize(Editor *e)
+// Forgets all the tokens and lexer states. editor_highlight() lexes the rows again once they are needed.
+static void editor_syntax_highlight(Editor *e)
 {
-    // Lines
-    {
-        e->lines.count = 0;
+    // NOTE: whatever the running job comes up with is about rows that no longer mean anything
+    highlighter_cancel(&e->highlighter);
+    e->generation += 1;
+    e->edited_row = 0;
+
+    da_reserve(&e->lexer_states, e->lines.count);
+    e->lexer_states.count = e->lines.count;
+    memset(e->lexer_states.items, 0, e->lexer_states.count*sizeof(*e->lexer_states.items));
+    e->states_known = 1;
+    e->states_guessed = 1;
+    e->states_dirty_end = 0;
+
+    e->tokens.count = 0;
+    e->highlight_begin = 0;
+    e->highlight_end = 0;
+}
 
-        Line line;
-        line.begin = 0;
+// Takes what the finished job found out. If the text was edited in the meantime, only the states of
+// the rows up to the first edited one are still right, and the tokens are thrown away.
+static void editor_highlight_done(Editor *e, Highlight_Job *job)
+{
+    bool current = job->generation == e->generation;
+    size_t reached = job->row + job->states.count;
+    if (!current && e->edited_row < reached) reached = e->edited_row + 1;
+    if (reached <= job->row) return;
+
+    memcpy(&e->lexer_states.items[job->row], job->states.items, (reached - job->row)*sizeof(*job->states.items));
+    if (e->states_known < reached) e->states_known = reached;
+
+    if (current) {
+        if (job->converged && e->states_known < e->states_guessed) e->states_known = e->states_guessed;
+        SWAP(Tokens, e->tokens, job->tokens);
+        e->highlight_begin = job->tokens_begin;
+        e->highlight_end = job->end;
+        e->highlight_generation = e->generation;
+    }
 
-        for (size_t i = 0; i < e->data.count; ++i) {
-            if (e->data.items[i] == '\n') {
-                line.end = i;
-                da_append(&e->lines, line);
-                line.begin = i + 1;
-            }
+    if (e->states_guessed < e->states_known) e->states_guessed = e->states_known;
+    if (e->states_dirty_end <= e->states_known) e->states_dirty_end = 0;
+}
+
+static void editor_highlight_poll(Editor *e)
+{
+    Highlight_Job *job = highlighter_poll(&e->highlighter);
+    if (job != NULL) editor_highlight_done(e, job);
+}
+
+// Lexes the rows [begin, end) in the background
+static void editor_highlight_start(Editor *e, size_t begin, size_t end)
+{
+    Highlight_Job *job = &e->highlighter.job;
+
+    size_t row = begin < e->states_known ? begin : e->states_known - 1;
+    job->snapshot.pieces.count = 0;
+    da_append_many(&job->snapshot.pieces, e->data.pieces.items, e->data.pieces.count);
+    job->snapshot.count = e->data.count;
+    job->row = row;
+    job->lexer = lexer_new_at_line(&job->snapshot, e->language, lines_at(&e->lines, row).begin, row, e->lexer_states.items[row]);
+    job->tokens_begin = begin;
+    job->end = end;
+
+    // Only the guessed rows past all of the edits can confirm the old states. Entering a known row
+    // in its state says nothing about the rows after an edit further down.
+    job->compare_begin = e->states_dirty_end > e->states_known ? e->states_dirty_end : e->states_known;
+    size_t compare_end = e->states_guessed < end + 1 ? e->states_guessed : end + 1;
+    job->old_states.count = 0;
+    if (job->compare_begin < compare_end) {
+        size_t compare_count = compare_end - job->compare_begin;
+        da_append_many(&job->old_states, &e->lexer_states.items[job->compare_begin], compare_count);
+    }
+
+    job->generation = e->generation;
+    e->edited_row = SIZE_MAX;
+    highlighter_start(&e->highlighter);
+}
+
+#define EDITOR_HIGHLIGHT_MARGIN 256
+
+void editor_highlight(Editor *e, size_t begin, size_t end)
+{
+    editor_flush_edits(e);
+    editor_highlight_poll(e);
+    if (highlighter_running(&e->highlighter)) return;
+
+    // While the file is being indexed its last line is the whole rest of the file
+    size_t rows = e->lines.count;
+    if (lines_indexing(&e->lines)) rows -= 1;
+    if (end > rows) end = rows;
+    if (begin > end) begin = end;
+    bool current = e->highlight_generation == e->generation;
+    if (current && begin >= e->highlight_begin && end <= e->highlight_end) return;
+
+    begin = begin > EDITOR_HIGHLIGHT_MARGIN ? begin - EDITOR_HIGHLIGHT_MARGIN : 0;
+    end = end + EDITOR_HIGHLIGHT_MARGIN < rows ? end + EDITOR_HIGHLIGHT_MARGIN : rows;
+    editor_highlight_start(e, begin, end);
+}
+
+// The amount of '\n' within the bytes [begin, end), *last is set to the offset of the last one
+static size_t editor_count_newlines(const Editor *e, size_t begin, size_t end, size_t *last)
+{
+    size_t count = 0;
+    while (begin < end) {
+        String_View chunk = buffer_chunk(&e->data, begin);
+        if (chunk.count > end - begin) chunk.count = end - begin;
+        const char *chunk_end = chunk.data + chunk.count;
+        for (const char *p = chunk.data; (p = memchr(p, '\n', chunk_end - p)) != NULL; ++p) {
+            *last = begin + (size_t) (p - chunk.data);
+            count += 1;
         }
+        begin += chunk.count;
+    }
+    return count;
+}
 
-        line.end = e->data.count;
-        da_append(&e->lines, line);
+// Moves the cursor cache past the `removed` bytes at pos while they are still in the text
+static void editor_cursor_removing(Editor *e, size_t pos, size_t removed)
+{
+    Cursor_Cache *cc = &e->cursor_cache;
+    if (!cc->valid || removed == 0 || pos >= cc->pos) return;
+
+    // Only the bytes before the cursor move it
+    size_t end = pos + removed < cc->pos ? pos + removed : cc->pos;
+    size_t line_begin = cc->pos - cc->col;
+    if (end < line_begin) {
+        size_t last;
+        cc->row -= editor_count_newlines(e, pos, end, &last);
+    } else if (pos < line_begin) {
+        // NOTE: the line break before the cursor goes, so where its line begins now would have to be looked up
+        cc->valid = false;
+        return;
+    } else {
+        if (cc->x_valid) {
+            Vec2f removed_pos = vec2fs(0.0f);
+            editor_measure_range(e, e->atlas, pos, end, &removed_pos, FLT_MAX);
+            cc->x -= removed_pos.x;
+        }
+        cc->col -= end - pos;
+        cc->preferred_col = cc->col;
     }
+    cc->pos -= end - pos;
+}
 
-    // Syntax Highlighting
-    {
-        e->tokens.count = 0;
-        Lexer l = lexer_new(e->atlas, e->data.items, e->data.count);
-        Token t = lexer_next(&l);
-        while (t.kind != TOKEN_END) {
-            da_append(&e->tokens, t);
-            t = lexer_next(&l);
+// Moves the cursor cache past the `inserted` bytes at pos. The cursor goes along with the bytes
+// inserted right at it.
+static void editor_cursor_inserted(Editor *e, size_t pos, size_t inserted)
+{
+    Cursor_Cache *cc = &e->cursor_cache;
+    if (!cc->valid || inserted == 0 || pos > cc->pos) return;
+
+    size_t line_begin = cc->pos - cc->col;
+    size_t last;
+    size_t newlines = editor_count_newlines(e, pos, pos + inserted, &last);
+    cc->row += newlines;
+    if (pos >= line_begin && newlines == 0) {
+        if (cc->x_valid) {
+            Vec2f inserted_pos = vec2f(cc->x, 0.0f);
+            editor_measure_range(e, e->atlas, pos, pos + inserted, &inserted_pos, FLT_MAX);
+            cc->x = inserted_pos.x;
+        }
+        cc->col += inserted;
+        cc->preferred_col = cc->col;
+    } else if (pos >= line_begin) {
+        // The line of the cursor now begins after the last inserted line break
+        cc->col = cc->pos + inserted - (last + 1);
+        cc->preferred_col = cc->col;
+        Vec2f line_pos = vec2fs(0.0f);
+        editor_measure_range(e, e->atlas, last + 1, cc->pos + inserted, &line_pos, FLT_MAX);
+        cc->x = line_pos.x;
+        cc->x_valid = true;
+    }
+    cc->pos += inserted;
+}
+
+// Called before `removed` bytes at pos are replaced. An edit that doesn't touch the dirty bytes
+// can't be merged with them without rescanning everything in between, so the flush happens now
+// while the buffer still has the text the dirty range describes.
+static void editor_will_edit(Editor *e, size_t pos, size_t removed)
+{
+    if (e->dirty && (pos > e->dirty_new_end || pos + removed < e->dirty_begin)) editor_flush_edits(e);
+    editor_cursor_removing(e, pos, removed);
+}
+
+// Called after `removed` bytes at pos were replaced with `inserted` bytes. Only marks the bytes
+// as dirty, editor_flush_edits() brings the lines and the tokens up to date for all of them at once.
+// The cursor cache is already up to date with them.
+static void editor_edited(Editor *e, size_t pos, size_t removed, size_t inserted)
+{
+    editor_cursor_inserted(e, pos, inserted);
+    regex_forget(&e->search_re);
+
+    if (!e->dirty) {
+        e->dirty = true;
+        e->dirty_begin = pos;
+        e->dirty_old_end = pos;
+        e->dirty_new_end = pos;
+    }
+
+    size_t end = e->dirty_new_end > pos + removed ? e->dirty_new_end : pos + removed;
+    if (e->dirty_begin > pos) e->dirty_begin = pos;
+    e->dirty_old_end += end - e->dirty_new_end;
+    e->dirty_new_end = end - removed + inserted;
+}
+
+// Replaces the lines and shifts the states and tokens of the dirty bytes, and relexes their rows
+static void editor_flush_edits(Editor *e)
+{
+    if (!e->dirty) return;
+    e->dirty = false;
+    size_t pos = e->dirty_begin;
+    size_t removed = e->dirty_old_end - e->dirty_begin;
+    size_t inserted = e->dirty_new_end - e->dirty_begin;
+
+    // NOTE: the running job lexes the text before these edits, it's not worth finishing
+    highlighter_cancel(&e->highlighter);
+    e->generation += 1;
+
+    size_t first = lines_row_of(&e->lines, pos);
+    size_t old_last = lines_row_of(&e->lines, pos + removed);
+    // While indexing the last row is the rest of the file, and an edit of it stays a part of it
+    bool rest = lines_indexing(&e->lines) && old_last + 1 == e->lines.count;
+    lines_splice(&e->lines, &e->data, pos, removed, inserted);
+    // NOTE: the cursor was counted in the rows of the edited text, not in ones that take the rest of the file for one
+    if (rest) e->cursor_cache.valid = false;
+    size_t new_last = lines_row_of(&e->lines, pos + inserted);
+    if (e->edited_row > first) e->edited_row = first;
+
+    // The rows after the first one that the edit touched are new, their states are unknown
+    Lexer_States *states = &e->lexer_states;
+    size_t old_rows = old_last - first;
+    size_t new_rows = new_last - first;
+    da_reserve(states, states->count - old_rows + new_rows);
+    memmove(&states->items[first + 1 + new_rows],
+            &states->items[first + 1 + old_rows],
+            (states->count - first - 1 - old_rows)*sizeof(*states->items));
+    memset(&states->items[first + 1], 0, new_rows*sizeof(*states->items));
+    states->count = states->count - old_rows + new_rows;
+    assert(states->count == e->lines.count);
+
+    // The states of the rows after the edit are kept as a guess that the highlighter checks later.
+    // NOTE: an edit of the known rows drops the older guesses past them. Those came from lexing older
+    // text, so entering a known row in its old state says nothing about them.
+    bool first_known = first < e->states_known;
+    if (first < e->states_guessed) {
+        size_t guessed = first_known ? e->states_known : e->states_guessed;
+        e->states_guessed = old_last < guessed ? guessed - old_rows + new_rows : first + 1;
+        if (first_known) e->states_dirty_end = 0;
+        if (e->states_dirty_end > old_last) e->states_dirty_end = e->states_dirty_end - old_rows + new_rows;
+        if (e->states_dirty_end < new_last + 1) e->states_dirty_end = new_last + 1;
+    }
+    if (e->states_known > first + 1) e->states_known = first + 1;
+
+    // Move the highlighted rows along with the text. If they overlap the edit they now cover all of its rows.
+    size_t begin = e->highlight_begin;
+    size_t end = e->highlight_end;
+    if (begin < end && end > first) {
+        if (begin > old_last) {
+            begin = begin - old_rows + new_rows;
+            end = end - old_rows + new_rows;
+        } else {
+            if (begin > first) begin = first;
+            end = end > old_last ? end - old_rows + new_rows : new_last + 1;
         }
     }
+    e->highlight_begin = begin;
+    e->highlight_end = end;
+
+    // The edited rows are relexed right away if there are few of them. What the edit does to the rows
+    // after them is up to the highlighter, until it's done they keep their old tokens.
+    ptrdiff_t delta = (ptrdiff_t) inserted - (ptrdiff_t) removed;
+    if (begin < end && begin <= new_last && end > first) {
+        Line line = lines_at(&e->lines, first);
+        size_t next_begin = new_last + 1 < e->lines.count ? lines_at(&e->lines, new_last + 1).begin : e->data.count;
+        size_t from = tokens_lower_bound(&e->tokens, line.begin);
+        size_t to = e->tokens.count;
+        if (new_last + 1 < e->lines.count) to = tokens_lower_bound(&e->tokens, next_begin - delta);
+
+        e->relexed.count = 0;
+        if (first_known && new_rows < EDITOR_HIGHLIGHT_MARGIN && !rest) {
+            Lexer l = lexer_new_at_line(&e->data, e->language, line.begin, first, states->items[first]);
+            for (Token t = lexer_next(&l); t.kind != TOKEN_END && t.begin < next_begin; t = lexer_next(&l)) {
+                tokens_append(&e->relexed, t);
+            }
+        }
+        tokens_replace(&e->tokens, from, to, &e->relexed);
+        if (delta != 0) tokens_shift(&e->tokens, from + e->relexed.count, delta);
+    } else if (begin > new_last && delta != 0) {
+        tokens_shift(&e->tokens, 0, delta);
+    }
+}
+
+void editor_retokenize(Editor *e)
+{
+    e->dirty = false;
+    if (!lines_indexing(&e->lines)) lines_rebuild(&e->lines, &e->data);
+    editor_syntax_highlight(e);
+}
+
+// Called once the lines index that had `rows` rows is done. Only its last row, which was the whole
+// rest of the file, got split up, so only a cursor on it has moved.
+static void editor_indexed(Editor *e, size_t rows)
+{
+    if (e->dirty || e->cursor_cache.row + 1 >= rows) e->cursor_cache.valid = false;
+    editor_syntax_highlight(e);
+}
+
+static void editor_finish_indexing(Editor *e)
+{
+    if (lines_indexing(&e->lines)) {
+        size_t rows = e->lines.count;
+        lines_index_finish(&e->lines);
+        editor_indexed(e, rows);
+    }
+}
+
+void editor_update(Editor *e)
+{
+    editor_flush_edits(e);
+    editor_highlight_poll(e);
+    if (lines_indexing(&e->lines)) {
+        size_t rows = e->lines.count;
+        lines_index_poll(&e->lines);
+        if (!lines_indexing(&e->lines)) editor_indexed(e, rows);
+    }
 }
 
 bool editor_line_starts_with(Editor *e, size_t row, size_t col, const char *prefix)
 {
+    editor_flush_edits(e);
     size_t prefix_len = strlen(prefix);
     if (prefix_len == 0) {
         return true;
     }
-    Line line = e->lines.items[row];
+    Line line = lines_at(&e->lines, row);
     if (col + prefix_len - 1 >= line.end) {
         return false;
     }
     for (size_t i = 0; i < prefix_len; ++i) {
-        if (prefix[i] != e->data.items[line.begin + col + i]) {
+        if (prefix[i] != buffer_at(&e->data, line.begin + col + i)) {
             return false;
         }
     }
@@ -353,8 +714,52 @@ const char *editor_line_starts_with_one_of(Editor *e, size_t row, size_t col, co
     return NULL;
 }
 
+// NOTE: long lines are measured and rendered in blocks, so the work stops soon after the right edge of the screen
+#define EDITOR_RENDER_BLOCK 64
+
+// Measures the bytes [begin, end), but stops once *pos is at or past right
+static void editor_measure_range(const Editor *e, Free_Glyph_Atlas *atlas, size_t begin, size_t end, Vec2f *pos, float right)
+{
+    while (begin < end && pos->x < right) {
+        String_View chunk = buffer_chunk(&e->data, begin);
+        if (chunk.count > end - begin) chunk.count = end - begin;
+        if (chunk.count > EDITOR_RENDER_BLOCK) chunk.count = EDITOR_RENDER_BLOCK;
+        free_glyph_atlas_measure_line_sized(atlas, chunk.data, chunk.count, pos);
+        begin += chunk.count;
+    }
+}
+
+// The x coordinates [*left, *right) that the camera of sr can see
+static void editor_visible_columns(const Simple_Renderer *sr, float *left, float *right)
+{
+    float half_width = sr->resolution.x/2.0f/sr->camera_scale;
+    *left = sr->camera_pos.x - half_width;
+    *right = sr->camera_pos.x + half_width;
+}
+
+// Renders the bytes [begin, end), but only the blocks of them that reach into [left, right).
+// Stops once *pos is at or past right like editor_measure_range().
+static void editor_render_range(const Editor *e, Free_Glyph_Atlas *atlas, Simple_Renderer *sr, size_t begin, size_t end, Vec2f *pos, Vec4f color, float left, float right)
+{
+    while (begin < end && pos->x < right) {
+        String_View chunk = buffer_chunk(&e->data, begin);
+        if (chunk.count > end - begin) chunk.count = end - begin;
+        if (chunk.count > EDITOR_RENDER_BLOCK) chunk.count = EDITOR_RENDER_BLOCK;
+        Vec2f block_end = *pos;
+        free_glyph_atlas_measure_line_sized(atlas, chunk.data, chunk.count, &block_end);
+        if (block_end.x > left) {
+            free_glyph_atlas_render_line_sized(atlas, sr, chunk.data, chunk.count, pos, color);
+        } else {
+            *pos = block_end;
+        }
+        begin += chunk.count;
+    }
+}
+
 void editor_render(Editor *editor, SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer *sr)
 {
+    editor_flush_edits(editor);
+
     int w, h;
     SDL_GetWindowSize(window, &w, &h);
 
@@ -363,18 +768,35 @@ void editor_render(Editor *editor, SDL_Window *window, Free_Glyph_Atlas *atlas,
     sr->resolution = vec2f(w, h);
     sr->time = (float) SDL_GetTicks() / 1000.0f;
 
+    size_t visible_begin, visible_end;
+    simple_renderer_visible_rows(sr, editor->lines.count, FREE_GLYPH_FONT_SIZE, &visible_begin, &visible_end);
+    editor_highlight(editor, visible_begin, visible_end);
+    float left, right;
+    editor_visible_columns(sr, &left, &right);
+    // NOTE: the camera zooms by how wide the lines are up to 1000, so at least that much is measured
+    if (right < 1000.0f) right = 1000.0f;
+
     // Render selection
     {
         simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
         if (editor->selection) {
-            for (size_t row = 0; row < editor->lines.count; ++row) {
-                size_t select_begin_chr = editor->select_begin;
-                size_t select_end_chr = editor->cursor;
-                if (select_begin_chr > select_end_chr) {
-                    SWAP(size_t, select_begin_chr, select_end_chr);
-                }
+            size_t select_begin = editor->select_begin;
+            size_t select_end = editor->cursor;
+            if (select_begin > select_end) {
+                SWAP(size_t, select_begin, select_end);
+            }
 
-                Line line_chr = editor->lines.items[row];
+            // NOTE: only the selected rows that are on the screen
+            size_t begin_row = lines_row_of(&editor->lines, select_begin);
+            size_t end_row = lines_row_of(&editor->lines, select_end) + 1;
+            if (begin_row < visible_begin) begin_row = visible_begin;
+            if (end_row > visible_end) end_row = visible_end;
+
+            for (size_t row = begin_row; row < end_row; ++row) {
+                size_t select_begin_chr = select_begin;
+                size_t select_end_chr = select_end;
+
+                Line line_chr = lines_at(&editor->lines, row);
 
                 if (select_begin_chr < line_chr.begin) {
                     select_begin_chr = line_chr.begin;
@@ -386,14 +808,10 @@ void editor_render(Editor *editor, SDL_Window *window, Free_Glyph_Atlas *atlas,
 
                 if (select_begin_chr <= select_end_chr) {
                     Vec2f select_begin_scr = vec2f(0, -((float)row + CURSOR_OFFSET) * FREE_GLYPH_FONT_SIZE);
-                    free_glyph_atlas_measure_line_sized(
-                        atlas, editor->data.items + line_chr.begin, select_begin_chr - line_chr.begin,
-                        &select_begin_scr);
+                    editor_measure_range(editor, atlas, line_chr.begin, select_begin_chr, &select_begin_scr, right);
 
                     Vec2f select_end_scr = select_begin_scr;
-                    free_glyph_atlas_measure_line_sized(
-                        atlas, editor->data.items + select_begin_chr, select_end_chr - select_begin_chr,
-                        &select_end_scr);
+                    editor_measure_range(editor, atlas, select_begin_chr, select_end_chr, &select_end_scr, right);
 
                     Vec4f selection_color = vec4f(.25, .25, .25, 1);
                     simple_renderer_solid_rect(sr, select_begin_scr, vec2f(select_end_scr.x - select_begin_scr.x, FREE_GLYPH_FONT_SIZE), selection_color);
@@ -405,10 +823,8 @@ void editor_render(Editor *editor, SDL_Window *window, Free_Glyph_Atlas *atlas,
 
     Vec2f cursor_pos = vec2fs(0.0f);
     {
-        size_t cursor_row = editor_cursor_row(editor);
-        Line line = editor->lines.items[cursor_row];
-        size_t cursor_col = editor->cursor - line.begin;
-        Vec2f target = vec2f(cursor_col, cursor_row);
+        Cursor_Cache *cc = editor_cursor(editor);
+        Vec2f target = vec2f(cc->col, cc->row);
 
         sr->cursor_vel = vec2f_mul(
                              vec2f_sub(target, sr->cursor_pos),
@@ -420,25 +836,26 @@ void editor_render(Editor *editor, SDL_Window *window, Free_Glyph_Atlas *atlas,
         cursor_pos.y = -((float)sr->cursor_pos.y + CURSOR_OFFSET) * FREE_GLYPH_FONT_SIZE;
         cursor_pos.x = sr->cursor_absolute_pos_x; // ((float)sr->cursor_pos.x + CURSOR_OFFSET) * (FREE_GLYPH_FONT_SIZE / 2.0 + 3.0);
 
-        float target_x = free_glyph_atlas_cursor_pos(
-                           atlas,
-                           editor->data.items + line.begin, line.end - line.begin,
-                           vec2f(0.0, sr->cursor_pos.y),
-                           cursor_col 
-                       );
+        if (!cc->x_valid) {
+            Vec2f target_pos = vec2fs(0.0f);
+            editor_measure_range(editor, atlas, editor->cursor - cc->col, editor->cursor, &target_pos, FLT_MAX);
+            cc->x = target_pos.x;
+            cc->x_valid = true;
+        }
+        float target_x = cc->x;
         float x_vel = (target_x - sr->cursor_absolute_pos_x) * 12.0f;
         sr->cursor_absolute_pos_x = + sr->cursor_absolute_pos_x + x_vel * DELTA_TIME;
     }
 
     // Render search
+    Vec2f search_end = cursor_pos;
     {
         if (editor->searching) {
             simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
             Vec4f selection_color = vec4f(.10, .10, .25, 1);
             Vec2f p1 = cursor_pos;
-            Vec2f p2 = p1;
-            free_glyph_atlas_measure_line_sized(editor->atlas, editor->search.items, editor->search.count, &p2);
-            simple_renderer_solid_rect(sr, p1, vec2f(p2.x - p1.x, FREE_GLYPH_FONT_SIZE), selection_color);
+            free_glyph_atlas_measure_line_sized(editor->atlas, editor->search.items, editor->search.count, &search_end);
+            simple_renderer_solid_rect(sr, p1, vec2f(search_end.x - p1.x, FREE_GLYPH_FONT_SIZE), selection_color);
             simple_renderer_flush(sr);
         }
     }
@@ -446,17 +863,66 @@ void editor_render(Editor *editor, SDL_Window *window, Free_Glyph_Atlas *atlas,
     // Render text
     {
         simple_renderer_set_shader(sr, SHADER_FOR_TEXT);
-        for (size_t i = 0; i < editor->tokens.count; ++i) {
-            Token token = editor->tokens.items[i];
-            Vec2f pos = token.position;
+        // NOTE: the tokens are laid out right here. The gaps between them are only measured.
+        size_t from = 0, to = 0;
+        Line line = lines_at(&editor->lines, visible_begin < editor->lines.count ? visible_begin : 0);
+        if (visible_begin < visible_end) {
+            size_t end = visible_end < editor->lines.count ? lines_at(&editor->lines, visible_end).begin : editor->data.count;
+            tokens_in_range(&editor->tokens, line.begin, end, &from, &to);
+        }
+        size_t x_end = line.begin;
+        Vec2f pos = vec2f(0.0f, -(float) visible_begin*FREE_GLYPH_FONT_SIZE);
+        for (size_t i = from; i < to; ++i) {
+            Token token = tokens_at(&editor->tokens, i);
+            if (token.begin > line.end) {
+                size_t row = lines_row_of(&editor->lines, token.begin);
+                line = lines_at(&editor->lines, row);
+                x_end = line.begin;
+                pos = vec2f(0.0f, -(float) row*FREE_GLYPH_FONT_SIZE);
+            } else if (pos.x >= right) {
+                // The rest of the line is off the screen, go straight to the tokens of the next one
+                i = tokens_lower_bound(&editor->tokens, line.end + 1) - 1;
+                continue;
+            }
+            editor_measure_range(editor, atlas, x_end, token.begin, &pos, right);
             Vec4f color = token_kind_color(token.kind);
-            free_glyph_atlas_render_line_sized(atlas, sr, token.text, token.text_len, &pos, color);
-            // TODO: the max_line_len should be calculated based on what's visible on the screen right now
+            editor_render_range(editor, atlas, sr, token.begin, token.begin + token.text_len, &pos, color, left, right);
+            x_end = token.begin + token.text_len;
+            if (max_line_len < pos.x) max_line_len = pos.x;
+        }
+        // The rows the highlighter hasn't got to yet are drawn plain
+        for (size_t row = visible_begin; row < visible_end; ++row) {
+            if (row >= editor->highlight_begin && row < editor->highlight_end) continue;
+            line = lines_at(&editor->lines, row);
+            pos = vec2f(0.0f, -(float) row*FREE_GLYPH_FONT_SIZE);
+            editor_render_range(editor, atlas, sr, line.begin, line.end, &pos, vec4fs(1), left, right);
             if (max_line_len < pos.x) max_line_len = pos.x;
         }
         simple_renderer_flush(sr);
     }
 
+    // Render which match of how many the cursor is on
+    if (editor->searching && editor->search.count > 0) {
+        Matches *m = editor_search_matches(editor);
+        size_t index = matches_lower_bound(m, editor->cursor);
+        bool on_match = index < m->count && m->items[index] == editor->cursor;
+        char counter[64];
+        int counter_len = snprintf(counter, sizeof(counter), " %zu/%zu%s ",
+                                   on_match ? index + 1 : 0, m->count, m->end < editor->data.count ? "+" : "");
+        if (editor->search_regex && editor->search_re.error != NULL) {
+            counter_len = snprintf(counter, sizeof(counter), " %s ", editor->search_re.error);
+        }
+
+        Vec2f end = search_end;
+        free_glyph_atlas_measure_line_sized(atlas, counter, counter_len, &end);
+        simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
+        simple_renderer_solid_rect(sr, search_end, vec2f(end.x - search_end.x, FREE_GLYPH_FONT_SIZE), vec4f(.05, .05, .05, 1));
+        simple_renderer_flush(sr);
+        simple_renderer_set_shader(sr, SHADER_FOR_TEXT);
+        free_glyph_atlas_render_line_sized(atlas, sr, counter, counter_len, &search_end, vec4f(.6, .6, .8, 1));
+        simple_renderer_flush(sr);
+    }
+
     // Render cursor
     simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
     {
@@ -531,9 +997,9 @@ void editor_update_selection(Editor *e, bool shift)
 
 void editor_clipboard_cut(Editor *e)
 {
+    if (e->searching || !e->selection) return;
     editor_clipboard_copy(e);
     editor_backspace_selection(e);
-    editor_retokenize(e);
 }
 
 void editor_clipboard_copy(Editor *e)
@@ -545,7 +1011,7 @@ void editor_clipboard_copy(Editor *e)
         if (begin > end) SWAP(size_t, begin, end);
 
         e->clipboard.count = 0;
-        sb_append_buf(&e->clipboard, &e->data.items[begin], end - begin + 1);
+        buffer_copy(&e->data, begin, end + 1, &e->clipboard);
         sb_append_null(&e->clipboard);
 
         if (SDL_SetClipboardText(e->clipboard.items) < 0) {
@@ -569,14 +1035,10 @@ void editor_clipboard_paste(Editor *e)
 void editor_start_search(Editor *e)
 {
     if (e->searching) {
-        for (size_t pos = e->cursor + 1; pos < e->data.count; ++pos) {
-            if (editor_search_matches_at(e, pos)) {
-                e->cursor = pos;
-                break;
-            }
-        }
+        editor_search_next(e, e->cursor + 1);
     } else {
         e->searching = true;
+        e->search_matches_valid = false;
         if (e->selection) {
             e->selection = false;
             // TODO: put the selection into the search automatically
@@ -589,67 +1051,191 @@ void editor_start_search(Editor *e)
 void editor_stop_search(Editor *e)
 {
     e->searching = false;
+    e->search_matches_valid = false;
+}
+
+static void editor_searcher(Editor *e, Searcher *s)
+{
+    searcher_init(s, e->search.items, e->search.count, e->search_ignore_case, e->search_whole_word);
+}
+
+// The first match that begins at or after from. The regex is compiled by editor_search_matches().
+static bool editor_search_find(Editor *e, size_t from, size_t *pos)
+{
+    if (e->search_regex) {
+        size_t end;
+        return regex_next(&e->search_re, &e->data, from, pos, &end);
+    }
+    Searcher s;
+    editor_searcher(e, &s);
+    return search_next(&s, &e->data, from, pos);
 }
 
 bool editor_search_matches_at(Editor *e, size_t pos)
 {
-    if (e->data.count - pos < e->search.count) return false;
-    for (size_t i = 0; i < e->search.count; ++i) {
-        if (e->search.items[i] != e->data.items[pos + i]) {
-            return false;
+    if (e->search_regex) {
+        if (e->search.count == 0) return false;
+        editor_search_matches(e);
+        size_t begin;
+        return editor_search_find(e, pos, &begin) && begin == pos;
+    }
+    Searcher s;
+    editor_searcher(e, &s);
+    return search_matches_at(&s, &e->data, pos);
+}
+
+void editor_search_toggle_ignore_case(Editor *e)
+{
+    e->search_ignore_case = !e->search_ignore_case;
+    e->search_matches_valid = false;
+}
+
+void editor_search_toggle_whole_word(Editor *e)
+{
+    e->search_whole_word = !e->search_whole_word;
+    e->search_matches_valid = false;
+}
+
+void editor_search_toggle_regex(Editor *e)
+{
+    e->search_regex = !e->search_regex;
+    e->search_matches_valid = false;
+}
+
+Matches *editor_search_matches(Editor *e)
+{
+    assert(e->search.count > 0);
+    if (!e->search_matches_valid) {
+        if (e->search_regex) {
+            regex_free(&e->search_re);
+            regex_compile(&e->search_re, e->search.items, e->search.count, e->search_ignore_case);
+            matches_find_regex(&e->search_matches, &e->search_re, &e->data);
+        } else {
+            Searcher s;
+            editor_searcher(e, &s);
+            matches_find(&e->search_matches, &s, &e->data);
+        }
+        e->search_matches_valid = true;
+    }
+    return &e->search_matches;
+}
+
+// The last match that begins within [begin, end). Goes through all of them, so only for the
+// matches that were too many to record.
+static bool editor_search_last(Editor *e, size_t begin, size_t end, size_t *pos)
+{
+    bool found = false;
+    size_t next;
+    while (editor_search_find(e, begin, &next) && next < end) {
+        *pos = next;
+        found = true;
+        begin = next + 1;
+    }
+    return found;
+}
+
+bool editor_search_next(Editor *e, size_t from)
+{
+    if (e->search.count == 0) return false;
+    Matches *m = editor_search_matches(e);
+    size_t index = matches_lower_bound(m, from);
+    size_t pos;
+    if (index < m->count) {
+        pos = m->items[index];
+    } else {
+        // Past the recorded matches, then around from the beginning
+        if (!editor_search_find(e, from > m->end ? from : m->end, &pos)) {
+            if (m->count > 0) {
+                pos = m->items[0];
+            } else if (from <= m->end || !editor_search_find(e, m->end, &pos)) {
+                return false;
+            }
+        }
+    }
+    e->cursor = pos;
+    return true;
+}
+
+bool editor_search_prev(Editor *e)
+{
+    if (e->search.count == 0) return false;
+    Matches *m = editor_search_matches(e);
+    size_t pos;
+    bool found = e->cursor > m->end && editor_search_last(e, m->end, e->cursor, &pos);
+    if (!found) {
+        size_t index = matches_lower_bound(m, e->cursor);
+        if (index > 0) {
+            pos = m->items[index - 1];
+            found = true;
+        }
+    }
+    if (!found) {
+        // Around from the end
+        found = editor_search_last(e, m->end, e->data.count, &pos);
+        if (!found && m->count > 0) {
+            pos = m->items[m->count - 1];
+            found = true;
         }
     }
+    if (!found) return false;
+    e->cursor = pos;
     return true;
 }
 
 void editor_move_to_begin(Editor *e)
 {
     editor_stop_search(e);
-    e->cursor = 0;
+    editor_cursor_set(e, 0, 0, 0);
 }
 
 void editor_move_to_end(Editor *e)
 {
     editor_stop_search(e);
-    e->cursor = e->data.count;
+    editor_flush_edits(e);
+    editor_finish_indexing(e);
+    size_t row = e->lines.count - 1;
+    size_t begin = lines_at(&e->lines, row).begin;
+    editor_cursor_set(e, row, begin, e->data.count - begin);
 }
 
 void editor_move_to_line_begin(Editor *e)
 {
     editor_stop_search(e);
-    size_t row = editor_cursor_row(e);
-    e->cursor = e->lines.items[row].begin;
+    Cursor_Cache *cc = editor_cursor(e);
+    editor_cursor_set(e, cc->row, e->cursor - cc->col, 0);
 }
 
 void editor_move_to_line_end(Editor *e)
 {
     editor_stop_search(e);
+    editor_finish_indexing(e);
     size_t row = editor_cursor_row(e);
-    e->cursor = e->lines.items[row].end;
+    Line line = lines_at(&e->lines, row);
+    editor_cursor_set(e, row, line.begin, line.end - line.begin);
 }
 
 void editor_move_paragraph_up(Editor *e)
 {
     editor_stop_search(e);
     size_t row = editor_cursor_row(e);
-    while (row > 0 && e->lines.items[row].end - e->lines.items[row].begin <= 1) {
+    while (row > 0 && lines_at(&e->lines, row).end - lines_at(&e->lines, row).begin <= 1) {
         row -= 1;
     }
-    while (row > 0 && e->lines.items[row].end - e->lines.items[row].begin > 1) {
+    while (row > 0 && lines_at(&e->lines, row).end - lines_at(&e->lines, row).begin > 1) {
         row -= 1;
     }
-    e->cursor = e->lines.items[row].begin;
+    editor_cursor_set(e, row, lines_at(&e->lines, row).begin, 0);
 }
 
 void editor_move_paragraph_down(Editor *e)
 {
     editor_stop_search(e);
     size_t row = editor_cursor_row(e);
-    while (row + 1 < e->lines.count && e->lines.items[row].end - e->lines.items[row].begin <= 1) {
+    while (row + 1 < e->lines.count && lines_at(&e->lines, row).end - lines_at(&e->lines, row).begin <= 1) {
         row += 1;
     }
-    while (row + 1 < e->lines.count && e->lines.items[row].end - e->lines.items[row].begin > 1) {
+    while (row + 1 < e->lines.count && lines_at(&e->lines, row).end - lines_at(&e->lines, row).begin > 1) {
         row += 1;
     }
-    e->cursor = e->lines.items[row].begin;
+    editor_cursor_set(e, row, lines_at(&e->lines, row).begin, 0);
 }
@@ -7,26 +7,15 @@
 #include "free_glyph.h"
 #include "simple_renderer.h"
 #include "lexer.h"
+#include "buffer.h"
+#include "lines.h"
+#include "tokens.h"
+#include "highlighter.h"
+#include "search.h"
+#include "regex.h"
 
 #include <SDL2/SDL.h>
 
-typedef struct {
-    size_t begin;
-    size_t end;
-} Line;
-
-typedef struct {
-    Line *items;
-    size_t count;
-    size_t capacity;
-} Lines;
-
-typedef struct {
-    Token *items;
-    size_t count;
-    size_t capacity;
-} Tokens;
-
 typedef enum {
     EDITOR_MODE_NORMAL,
     EDITOR_MODE_INSERT,
@@ -35,20 +24,59 @@ typedef enum {
     __EDITOR_MODE_SIZE,
 } Editor_Mode;
 
+// Where the cursor is in terms of lines. The motions and the edits keep it up to date step by
+// step, so they never search for the cursor. Code that just assigns Editor.cursor is fine too: the
+// cache sees that it describes another offset and looks the cursor up again.
+typedef struct {
+    bool valid;
+    size_t pos;           // the offset this describes
+    size_t row;
+    size_t col;           // bytes from the beginning of the row
+    size_t preferred_col; // the column vertical motions try to get back to
+    bool x_valid;
+    float x;              // visual position within the line
+} Cursor_Cache;
+
 typedef struct {
     Free_Glyph_Atlas *atlas;
 
-    String_Builder data;
+    Buffer data;
     Lines lines;
-    Tokens tokens;
+    const Language *language;
+    // The edits since the last editor_flush_edits(): the bytes [dirty_begin, dirty_old_end)
+    // of the text that lines and tokens describe are now [dirty_begin, dirty_new_end)
+    bool dirty;
+    size_t dirty_begin;
+    size_t dirty_old_end;
+    size_t dirty_new_end;
+    // Only the rows around the ones on the screen are highlighted, see editor_highlight()
+    Tokens tokens;             // the tokens of the rows [highlight_begin, highlight_end)
+    size_t highlight_begin;
+    size_t highlight_end;
+    size_t highlight_generation; // the version of the text the tokens were lexed from
+    Lexer_States lexer_states; // the state of the lexer at the beginning of every row
+    size_t states_known;       // lexer_states are only up to date for the rows [0, states_known)
+    size_t states_guessed;     // the rows [states_known, states_guessed) keep their states from before the latest edits,
+    size_t states_dirty_end;   // which are confirmed by entering one of them at or past this row in the same state
+    Tokens relexed;            // scratch space for re-lexing
+    Highlighter highlighter;
+    size_t generation;         // bumped by every edit
+    size_t edited_row;         // the first row edited since the running highlight job was started
     String_Builder file_path;
 
     bool searching;
     String_Builder search;
+    bool search_ignore_case;
+    bool search_whole_word;     // not for regexes
+    bool search_regex;          // search is a pattern, see regex.h
+    Regex search_re;            // compiled along with search_matches
+    Matches search_matches;
+    bool search_matches_valid;  // search_matches are the matches of search as it is
 
     bool selection;
     size_t select_begin;
     size_t cursor;
+    Cursor_Cache cursor_cache;
 
     Uint32 last_stroke;
 
@@ -61,9 +89,13 @@ Errno editor_save_as(Editor *editor, const char *file_path);
 Errno editor_save(const Editor *editor);
 Errno editor_load_from_file(Editor *editor, const char *file_path);
 
+// Removes the bytes [begin, end) with a single buffer edit. Every deletion goes through here.
+void editor_delete_range(Editor *e, size_t begin, size_t end);
 void editor_backspace(Editor *editor, bool control);
 void editor_delete(Editor *editor, bool control);
-size_t editor_cursor_row(const Editor *e);
+size_t editor_cursor_row(Editor *e);
+// Moves the cursor to the row keeping its column where possible
+void editor_move_to_line(Editor *e, size_t row);
 
 void editor_move_line_up(Editor *e);
 void editor_move_line_down(Editor *e);
@@ -85,6 +117,13 @@ void editor_move_paragraph_down(Editor *e);
 void editor_insert_char(Editor *e, char x);
 void editor_insert_buf(Editor *e, char *buf, size_t buf_len);
 void editor_retokenize(Editor *e);
+// Makes sure the rows [begin, end) and a margin around them get tokens. They are lexed in the
+// background, starting from the closest row with a known lexer state. Until the job is done the
+// old tokens stay, moved along with the edits. Far away tokens are dropped.
+void editor_highlight(Editor *e, size_t begin, size_t end);
+// Brings the lines and tokens up to date with the edits of the frame and picks up the work
+// done in the background. Call it every frame before editor_render().
+void editor_update(Editor *e);
 void editor_render(Editor *editor, SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer *sr);
 void editor_update_selection(Editor *e, bool shift);
 void editor_clipboard_cut(Editor *e);
@@ -93,5 +132,15 @@ void editor_clipboard_paste(Editor *e);
 void editor_start_search(Editor *e);
 void editor_stop_search(Editor *e);
 bool editor_search_matches_at(Editor *e, size_t pos);
+void editor_search_toggle_ignore_case(Editor *e);
+void editor_search_toggle_whole_word(Editor *e);
+void editor_search_toggle_regex(Editor *e);
+// All the matches of the search. It must not be empty.
+Matches *editor_search_matches(Editor *e);
+// Moves the cursor to the first match at or after from, or the first one of all if there is none
+// after it. Returns false if there are no matches at all.
+bool editor_search_next(Editor *e, size_t from);
+// Moves the cursor to the last match before it, or the last one of all if there is none before it.
+bool editor_search_prev(Editor *e);
 
 #endif // EDITOR_H_
@@ -130,18 +130,8 @@ Errno fb_change_dir(File_Browser *fb)
     return 0;
 }
 
-void fb_render(const File_Browser *fb, SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer *sr)
+static void fb_render_files(const File_Browser *fb, Free_Glyph_Atlas *atlas, Simple_Renderer *sr, float *max_line_len)
 {
-    Vec2f cursor_pos = vec2f(0, -(float)fb->cursor * FREE_GLYPH_FONT_SIZE);
-
-    int w, h;
-    SDL_GetWindowSize(window, &w, &h);
-
-    float max_line_len = 0.0f;
-
-    sr->resolution = vec2f(w, h);
-    sr->time = (float) SDL_GetTicks() / 1000.0f;
-
     simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
     if (fb->cursor < fb->files.count) {
         const Vec2f begin = vec2f(0, -((float)fb->cursor + CURSOR_OFFSET) * FREE_GLYPH_FONT_SIZE);
@@ -156,8 +146,11 @@ void fb_render(const File_Browser *fb, SDL_Window *window, Free_Glyph_Atlas *atl
     }
     simple_renderer_flush(sr);
 
+    size_t visible_begin, visible_end;
+    simple_renderer_visible_rows(sr, fb->files.count, FREE_GLYPH_FONT_SIZE, &visible_begin, &visible_end);
+
     simple_renderer_set_shader(sr, SHADER_FOR_EPICNESS);
-    for (size_t row = 0; row < fb->files.count; ++row) {
+    for (size_t row = visible_begin; row < visible_end; ++row) {
         const Vec2f begin = vec2f(0, -(float)row * FREE_GLYPH_FONT_SIZE);
         Vec2f end = begin;
         free_glyph_atlas_render_line_sized(
@@ -167,14 +160,97 @@ void fb_render(const File_Browser *fb, SDL_Window *window, Free_Glyph_Atlas *atl
         if (fb->files.items[row].type == FT_DIRECTORY) {
             free_glyph_atlas_render_line_sized(atlas, sr, "/", 1, &end, vec4fs(0));
         }
-        // TODO: the max_line_len should be calculated based on what's visible on the screen right now
         float line_len = fabsf(end.x - begin.x);
-        if (line_len > max_line_len) {
-            max_line_len = line_len;
+        if (line_len > *max_line_len) {
+            *max_line_len = line_len;
         }
     }
 
     simple_renderer_flush(sr);
+}
+
+// The "path:row: " in front of the line of a result, with the path relative to the searched dir
+static int fb_result_label(const Project_Search *ps, const Project_Search_Result *r, char *label, size_t label_size)
+{
+    const char *path = ps->strings.items + r->path;
+    size_t root_len = ps->root.count - 1;
+    if (strncmp(path, ps->root.items, root_len) == 0 && path[root_len] == '/') path += root_len + 1;
+    int label_len = snprintf(label, label_size, "%s:%zu: ", path, r->row + 1);
+    if (label_len < 0) return 0;
+    if ((size_t) label_len >= label_size) return (int) label_size - 1;
+    return label_len;
+}
+
+// The prompt with the needle on the first row, the lines that were found on the rows after it
+static void fb_render_search(const File_Browser *fb, Free_Glyph_Atlas *atlas, Simple_Renderer *sr, float *max_line_len)
+{
+    const Project_Search *ps = &fb->search;
+    char label[512];
+    int label_len;
+
+    Vec2f pos = vec2f(0, 0);
+    char status[128];
+    int status_len = 0;
+    if (ps->error != NULL) {
+        status_len = snprintf(status, sizeof(status), " %s ", ps->error);
+    } else if (fb->showing_results) {
+        status_len = snprintf(status, sizeof(status), " %zu lines in %zu files%s ",
+                              ps->results.count, ps->files, ps->running ? "..." : "");
+    }
+    simple_renderer_set_shader(sr, SHADER_FOR_TEXT);
+    free_glyph_atlas_render_line_sized(atlas, sr, "Search: ", 8, &pos, vec4f(.6, .6, .8, 1));
+    free_glyph_atlas_render_line_sized(atlas, sr, fb->needle.items, fb->needle.count, &pos, vec4fs(1));
+    free_glyph_atlas_render_line_sized(atlas, sr, status, status_len, &pos, vec4f(.6, .6, .8, 1));
+    simple_renderer_flush(sr);
+    if (pos.x > *max_line_len) *max_line_len = pos.x;
+
+    // NOTE: there can be a lot of results, so only the ones on the screen are rendered
+    size_t visible_begin, visible_end;
+    simple_renderer_visible_rows(sr, ps->results.count + 1, FREE_GLYPH_FONT_SIZE, &visible_begin, &visible_end);
+    if (visible_begin < 1) visible_begin = 1;
+
+    simple_renderer_set_shader(sr, SHADER_FOR_COLOR);
+    if (fb->showing_results && fb->result_cursor < ps->results.count) {
+        const Project_Search_Result *r = &ps->results.items[fb->result_cursor];
+        const Vec2f begin = vec2f(0, -((float)fb->result_cursor + 1 + CURSOR_OFFSET) * FREE_GLYPH_FONT_SIZE);
+        Vec2f end = begin;
+        label_len = fb_result_label(ps, r, label, sizeof(label));
+        free_glyph_atlas_measure_line_sized(atlas, label, label_len, &end);
+        free_glyph_atlas_measure_line_sized(atlas, ps->strings.items + r->line, r->line_count, &end);
+        simple_renderer_solid_rect(sr, begin, vec2f(end.x - begin.x, FREE_GLYPH_FONT_SIZE), vec4f(.25, .25, .25, 1));
+    }
+    simple_renderer_flush(sr);
+
+    simple_renderer_set_shader(sr, SHADER_FOR_TEXT);
+    for (size_t row = visible_begin; row < visible_end; ++row) {
+        const Project_Search_Result *r = &ps->results.items[row - 1];
+        pos = vec2f(0, -(float)row * FREE_GLYPH_FONT_SIZE);
+        label_len = fb_result_label(ps, r, label, sizeof(label));
+        free_glyph_atlas_render_line_sized(atlas, sr, label, label_len, &pos, vec4f(.6, .6, .8, 1));
+        free_glyph_atlas_render_line_sized(atlas, sr, ps->strings.items + r->line, r->line_count, &pos, vec4fs(1));
+        if (pos.x > *max_line_len) *max_line_len = pos.x;
+    }
+    simple_renderer_flush(sr);
+}
+
+void fb_render(const File_Browser *fb, SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer *sr)
+{
+    int w, h;
+    SDL_GetWindowSize(window, &w, &h);
+
+    float max_line_len = 0.0f;
+
+    sr->resolution = vec2f(w, h);
+    sr->time = (float) SDL_GetTicks() / 1000.0f;
+
+    Vec2f cursor_pos;
+    if (fb->typing || fb->showing_results) {
+        cursor_pos = vec2f(0, fb->showing_results ? -(float)(fb->result_cursor + 1) * FREE_GLYPH_FONT_SIZE : 0.0f);
+        fb_render_search(fb, atlas, sr, &max_line_len);
+    } else {
+        cursor_pos = vec2f(0, -(float)fb->cursor * FREE_GLYPH_FONT_SIZE);
+        fb_render_files(fb, atlas, sr, &max_line_len);
+    }
 
     // Update camera
     {
@@ -220,3 +296,34 @@ const char *fb_file_path(File_Browser *fb)
 
     return fb->file_path.items;
 }
+
+void fb_start_search(File_Browser *fb, bool ignore_case, bool whole_word, bool regex)
+{
+    assert(fb->dir_path.count > 0 && "You need to call fb_open_dir() before fb_start_search()");
+    project_search_start(&fb->search, fb->dir_path.items, fb->needle.items, fb->needle.count,
+                         ignore_case, whole_word, regex);
+    fb->typing = false;
+    fb->showing_results = true;
+    fb->result_cursor = 0;
+}
+
+void fb_stop_search(File_Browser *fb)
+{
+    project_search_stop(&fb->search);
+    fb->typing = false;
+    fb->showing_results = false;
+}
+
+const char *fb_result_path(File_Browser *fb, size_t *pos)
+{
+    const Project_Search *ps = &fb->search;
+    if (!fb->showing_results || fb->result_cursor >= ps->results.count) return NULL;
+
+    const Project_Search_Result *r = &ps->results.items[fb->result_cursor];
+    fb->file_path.count = 0;
+    sb_append_cstr(&fb->file_path, ps->strings.items + r->path);
+    sb_append_null(&fb->file_path);
+    *pos = r->pos;
+
+    return fb->file_path.items;
+}
@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "free_glyph.h"
+#include "project_search.h"
 
 #include <SDL2/SDL.h>
 
@@ -11,11 +12,22 @@ typedef struct {
     size_t cursor;
     String_Builder dir_path;
     String_Builder file_path;
+
+    // Looking for text in every file under dir_path
+    bool typing;              // the needle is being typed
+    bool showing_results;
+    String_Builder needle;
+    size_t result_cursor;
+    Project_Search search;
 } File_Browser;
 
 Errno fb_open_dir(File_Browser *fb, const char *dir_path);
 Errno fb_change_dir(File_Browser *fb);
 void fb_render(const File_Browser *fb, SDL_Window *window, Free_Glyph_Atlas *atlas, Simple_Renderer *sr);
 const char *fb_file_path(File_Browser *fb);
+void fb_start_search(File_Browser *fb, bool ignore_case, bool whole_word, bool regex);
+void fb_stop_search(File_Browser *fb);
+// The file and the position in it of the result under the cursor, NULL if there is none.
+const char *fb_result_path(File_Browser *fb, size_t *pos);
 
 #endif // FILE_BROWSER_H_
@@ -73,6 +73,22 @@ void free_glyph_atlas_init(Free_Glyph_Atlas *atlas, FT_Face face)
             face->glyph->bitmap.buffer);
         x += face->glyph->bitmap.width;
     }
+
+    // NOTE: the GPU gets the metrics too, so a glyph only needs its index to be drawn. The quad of
+    // glyph i is glyphs_rects[i] relative to the pen and glyphs_uvs[i] in the atlas.
+    Vec4f glyphs[2*GLYPH_METRICS_CAPACITY] = {0};
+    for (int i = 0; i < GLYPH_METRICS_CAPACITY; ++i) {
+        Glyph_Metric metric = atlas->metrics[i];
+        glyphs[i] = vec4f(metric.bl, metric.bt, metric.bw, -metric.bh);
+        glyphs[GLYPH_METRICS_CAPACITY + i] = vec4f(
+            metric.tx, 0.0f,
+            metric.bw / (float) atlas->atlas_width,
+            metric.bh / (float) atlas->atlas_height);
+    }
+    glGenBuffers(1, &atlas->metrics_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, atlas->metrics_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glyphs), glyphs, GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SIMPLE_GLYPHS_BINDING, atlas->metrics_buffer);
 }
 
 float free_glyph_atlas_cursor_pos(const Free_Glyph_Atlas *atlas, const char *text, size_t text_size, Vec2f pos, size_t col)
@@ -119,20 +135,12 @@ void free_glyph_atlas_render_line_sized(Free_Glyph_Atlas *atlas, Simple_Renderer
             glyph_index = '?';
         }
         Glyph_Metric metric = atlas->metrics[glyph_index];
-        float x2 = pos->x + metric.bl;
-        float y2 = -pos->y - metric.bt;
-        float w  = metric.bw;
-        float h  = metric.bh;
+        // NOTE: the likes of space have nothing to draw
+        if (metric.bw > 0.0f && metric.bh > 0.0f) {
+            simple_renderer_glyph(sr, *pos, (uint32_t) glyph_index, color);
+        }
 
         pos->x += metric.ax;
         pos->y += metric.ay;
-
-        simple_renderer_image_rect(
-            sr,
-            vec2f(x2, -y2),
-            vec2f(w, -h),
-            vec2f(metric.tx, 0.0f),
-            vec2f(metric.bw / (float) atlas->atlas_width, metric.bh / (float) atlas->atlas_height),
-            color);
     }
 }
@@ -31,12 +31,14 @@ typedef struct {
     float tx; // x offset of glyph in texture coordinates
 } Glyph_Metric;
 
+// NOTE: shaders/simple_glyph.vert has the same capacity for its metrics
 #define GLYPH_METRICS_CAPACITY 128
 
 typedef struct {
     FT_UInt atlas_width;
     FT_UInt atlas_height;
     GLuint glyphs_texture;
+    GLuint metrics_buffer; // the uniform block of shaders/simple_glyph.vert
     Glyph_Metric metrics[GLYPH_METRICS_CAPACITY];
 } Free_Glyph_Atlas;
 
@@ -0,0 +1,150 @@
+#include <assert.h>
+#include "./common.h"
+#include "./highlighter.h"
+
+// Tokens are only collected for this many bytes of a row. The rest of a longer row goes in as a single
+// plain token, like the renderer stops at the right edge of the screen.
+#define HIGHLIGHT_ROW_BYTES (16*1024)
+// How many tokens are lexed between two looks at whether the job was cancelled
+#define HIGHLIGHT_CANCEL_TOKENS 1024
+
+static void highlight_job_run(Highlight_Job *job, SDL_atomic_t *cancel)
+{
+    Lexer *l = &job->lexer;
+    size_t row = job->row;
+    job->states.count = 0;
+    job->tokens.count = 0;
+    job->converged = false;
+    da_append(&job->states, l->state);
+    if (row >= job->end) return;
+
+    Token rest = {.kind = TOKEN_INVALID};
+    size_t rest_row = SIZE_MAX;
+    bool done = false;
+    for (size_t count = 1; !done; ++count) {
+        size_t bol = l->bol;
+        size_t line = l->line;
+        Token t = lexer_next(l);
+        if (t.kind != TOKEN_END) {
+            // NOTE: tokens never span several rows, so only one that ends with a newline began before l->bol
+            size_t token_row = t.begin < l->bol ? l->line - 1 : l->line;
+            // Such a token is on the row the lexer was on, unless rows were skipped to get to it and it's the first one of its row
+            if (t.begin >= l->bol) bol = l->bol;
+            else if (token_row != line) bol = t.begin;
+
+            if (rest_row != SIZE_MAX && rest_row != token_row) {
+                tokens_append(&job->tokens, rest);
+                rest_row = SIZE_MAX;
+            }
+            if (token_row >= job->tokens_begin && token_row < job->end) {
+                if (t.begin - bol < HIGHLIGHT_ROW_BYTES) {
+                    tokens_append(&job->tokens, t);
+                } else if (rest_row == token_row) {
+                    rest.text_len = t.begin + t.text_len - rest.begin;
+                } else {
+                    rest.begin = t.begin;
+                    rest.text_len = t.text_len;
+                    rest_row = token_row;
+                }
+            }
+        }
+        while (row < l->line) {
+            row += 1;
+            // Whitespace that skips over rows always leaves them in the normal state
+            Lexer_State state = LEXER_STATE_NORMAL;
+            if (row == l->line && l->cursor == l->bol) state = l->state;
+            da_append(&job->states, state);
+            if (!job->converged && row >= job->compare_begin && row - job->compare_begin < job->old_states.count) {
+                job->converged = job->old_states.items[row - job->compare_begin] == state;
+            }
+            if (row >= job->end || SDL_AtomicGet(cancel)) {
+                done = true;
+                break;
+            }
+        }
+        // NOTE: a single long row is lexed for a while, so the job looks at cancel within rows too
+        if (t.kind == TOKEN_END || (count%HIGHLIGHT_CANCEL_TOKENS == 0 && SDL_AtomicGet(cancel))) done = true;
+    }
+    if (rest_row != SIZE_MAX) tokens_append(&job->tokens, rest);
+}
+
+static int SDLCALL highlighter_worker(void *data)
+{
+    Highlighter *h = data;
+    SDL_LockMutex(h->lock);
+    for (;;) {
+        while (!h->queued) SDL_CondWait(h->wake, h->lock);
+        h->queued = false;
+        SDL_UnlockMutex(h->lock);
+
+        highlight_job_run(&h->job, &h->cancel);
+
+        SDL_LockMutex(h->lock);
+        SDL_AtomicSetPtr(&h->done, &h->job);
+        SDL_CondBroadcast(h->wake);
+    }
+    return 0;
+}
+
+// Creates the worker, which lives as long as the editor does
+static bool highlighter_spawn(Highlighter *h)
+{
+    if (h->lock == NULL) h->lock = SDL_CreateMutex();
+    if (h->wake == NULL) h->wake = SDL_CreateCond();
+    if (h->lock == NULL || h->wake == NULL) return false;
+    h->thread = SDL_CreateThread(highlighter_worker, "highlighter", h);
+    return h->thread != NULL;
+}
+
+void highlighter_start(Highlighter *h)
+{
+    assert(!h->running && "Pick up the previous job first");
+    SDL_AtomicSet(&h->cancel, 0);
+    SDL_AtomicSetPtr(&h->done, NULL);
+    h->running = true;
+
+    if (h->thread == NULL && !highlighter_spawn(h)) {
+        // NOTE: no thread is not fatal, we just do the work ourselves
+        highlight_job_run(&h->job, &h->cancel);
+        SDL_AtomicSetPtr(&h->done, &h->job);
+        return;
+    }
+
+    // NOTE: the worker only holds the lock to take a job or hand it back, so this doesn't wait for long
+    SDL_LockMutex(h->lock);
+    h->queued = true;
+    SDL_CondSignal(h->wake);
+    SDL_UnlockMutex(h->lock);
+}
+
+bool highlighter_running(const Highlighter *h)
+{
+    return h->running;
+}
+
+void highlighter_cancel(Highlighter *h)
+{
+    if (h->running) SDL_AtomicSet(&h->cancel, 1);
+}
+
+Highlight_Job *highlighter_poll(Highlighter *h)
+{
+    if (!h->running) return NULL;
+    Highlight_Job *job = SDL_AtomicSetPtr(&h->done, NULL);
+    if (job == NULL) return NULL;
+    h->running = false;
+    return job;
+}
+
+Highlight_Job *highlighter_finish(Highlighter *h)
+{
+    if (!h->running) return NULL;
+    if (h->thread != NULL) {
+        SDL_LockMutex(h->lock);
+        while (SDL_AtomicGetPtr(&h->done) == NULL) SDL_CondWait(h->wake, h->lock);
+        SDL_UnlockMutex(h->lock);
+    }
+    h->running = false;
+    SDL_AtomicSetPtr(&h->done, NULL);
+    return &h->job;
+}
@@ -0,0 +1,58 @@
+#ifndef HIGHLIGHTER_H_
+#define HIGHLIGHTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "./buffer.h"
+#include "./lexer.h"
+#include "./tokens.h"
+
+#include <SDL2/SDL.h>
+
+typedef struct {
+    Lexer_State *items;
+    size_t count;
+    size_t capacity;
+} Lexer_States;
+
+// A run of the lexer over a snapshot of the buffer. The editor fills in the input, the
+// highlighter lexes it on its own thread and the editor picks up the output once it's done.
+typedef struct {
+    Buffer snapshot;          // shares the text with the buffer, only the pieces are copied
+    size_t row;               // the first row to lex
+    Lexer lexer;              // at the beginning of that row, in the state it is known to be in
+    size_t tokens_begin;      // tokens are collected for the rows [tokens_begin, end)
+    size_t end;               // the lexer stops upon entering this row
+    size_t compare_begin;
+    Lexer_States old_states;  // the states of the rows from compare_begin on before the latest edits
+    size_t generation;        // which version of the text the snapshot is
+
+    Lexer_States states;      // the states of the rows [row, row + states.count)
+    Tokens tokens;            // the rest of a very long row is a single plain token
+    bool converged;           // entered one of old_states in the same state, so the rest of them are right
+} Highlight_Job;
+
+// Runs a single Highlight_Job at a time in the background. The worker thread is created by the
+// first job and then sleeps until the next one, so starting a job costs no thread.
+typedef struct {
+    Highlight_Job job;
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *wake;           // the worker waits on it for a job, highlighter_finish() for the job to be done
+    bool queued;              // the job waits for the worker, under lock
+    SDL_atomic_t cancel;
+    void *done;               // the finished job, published by the worker under lock
+    bool running;
+} Highlighter;
+
+// Starts lexing h->job. The snapshot has to stay valid until the job is picked up.
+void highlighter_start(Highlighter *h);
+bool highlighter_running(const Highlighter *h);
+// Makes the running job stop soon, within the row it is on. The rows it did so far are still handed out.
+void highlighter_cancel(Highlighter *h);
+// The finished job or NULL if it's still running. Never blocks.
+Highlight_Job *highlighter_poll(Highlighter *h);
+// Blocks until the running job is finished and returns it, or NULL if nothing was running.
+Highlight_Job *highlighter_finish(Highlighter *h);
+
+#endif // HIGHLIGHTER_H_
@@ -1,10 +1,10 @@
 #include <assert.h>
 #include <stdbool.h>
-#include <ctype.h>
 #include <string.h>
 #include "common.h"
 #include "la.h"
 #include "lexer.h"
+#include "scan.h"
 
 typedef struct {
     Token_Kind kind;
@@ -20,26 +20,325 @@ Literal_Token literal_tokens[] = {
 };
 #define literal_tokens_count (sizeof(literal_tokens)/sizeof(literal_tokens[0]))
 
-const char *keywords[] = {
-    "auto", "char", "const", "double", "enum", "extern", "float", "int", "long",
-    "register", "short", "signed", "sizeof", "static", "struct", "typedef", "union",
-    "unsigned", "void", "volatile", "while", "alignas", "alignof", "and", "and_eq",
-    "asm", "atomic_cancel", "atomic_commit", "atomic_noexcept", "bitand", "bitor",
-    "bool", "char16_t", "char32_t", "char8_t", "class", "compl", "concept", "const_cast",
-    "consteval", "constexpr", "constinit", "decltype", "delete", "dynamic_cast", "explicit",
-    "export", "false", "friend", "inline", "mutable", "namespace", "new", "noexcept", "not",
-    "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public",
-    "reflexpr", "reinterpret_cast", "requires", "static_assert", "static_cast", "synchronized",
-    "template", "this", "thread_local", "true", "typeid", "typename", "using", "virtual",
-    "wchar_t", "xor", "xor_eq",
+// Character classes of the lexer
+enum {
+    CHAR_SPACE        = 1 << 0,
+    CHAR_SYMBOL_START = 1 << 1,
+    CHAR_SYMBOL       = 1 << 2,
+    CHAR_CAPS         = 1 << 3, // what a symbol may consist of to count as all caps
+    CHAR_DIGIT        = 1 << 4,
 };
-#define keywords_count (sizeof(keywords)/sizeof(keywords[0]))
 
-const char *control_flow[] = {
-    "break", "case", "continue", "default", "do", "else", "for", "goto", "if", "return",
-    "switch", "while", "catch", "co_await", "co_return", "co_yield", "try"
+#define CHAR_LOWER (CHAR_SYMBOL_START | CHAR_SYMBOL)
+#define CHAR_UPPER (CHAR_SYMBOL_START | CHAR_SYMBOL | CHAR_CAPS)
+#define CHAR_NUMERAL (CHAR_SYMBOL | CHAR_CAPS | CHAR_DIGIT)
+
+static const uint8_t char_class[256] = {
+    [' '] = CHAR_SPACE, ['\t'] = CHAR_SPACE, ['\n'] = CHAR_SPACE,
+    ['\v'] = CHAR_SPACE, ['\f'] = CHAR_SPACE, ['\r'] = CHAR_SPACE,
+    ['a'] = CHAR_LOWER, ['b'] = CHAR_LOWER, ['c'] = CHAR_LOWER, ['d'] = CHAR_LOWER, ['e'] = CHAR_LOWER, ['f'] = CHAR_LOWER, ['g'] = CHAR_LOWER,
+    ['h'] = CHAR_LOWER, ['i'] = CHAR_LOWER, ['j'] = CHAR_LOWER, ['k'] = CHAR_LOWER, ['l'] = CHAR_LOWER, ['m'] = CHAR_LOWER, ['n'] = CHAR_LOWER,
+    ['o'] = CHAR_LOWER, ['p'] = CHAR_LOWER, ['q'] = CHAR_LOWER, ['r'] = CHAR_LOWER, ['s'] = CHAR_LOWER, ['t'] = CHAR_LOWER, ['u'] = CHAR_LOWER,
+    ['v'] = CHAR_LOWER, ['w'] = CHAR_LOWER, ['x'] = CHAR_LOWER, ['y'] = CHAR_LOWER, ['z'] = CHAR_LOWER,
+    ['A'] = CHAR_UPPER, ['B'] = CHAR_UPPER, ['C'] = CHAR_UPPER, ['D'] = CHAR_UPPER, ['E'] = CHAR_UPPER, ['F'] = CHAR_UPPER, ['G'] = CHAR_UPPER,
+    ['H'] = CHAR_UPPER, ['I'] = CHAR_UPPER, ['J'] = CHAR_UPPER, ['K'] = CHAR_UPPER, ['L'] = CHAR_UPPER, ['M'] = CHAR_UPPER, ['N'] = CHAR_UPPER,
+    ['O'] = CHAR_UPPER, ['P'] = CHAR_UPPER, ['Q'] = CHAR_UPPER, ['R'] = CHAR_UPPER, ['S'] = CHAR_UPPER, ['T'] = CHAR_UPPER, ['U'] = CHAR_UPPER,
+    ['V'] = CHAR_UPPER, ['W'] = CHAR_UPPER, ['X'] = CHAR_UPPER, ['Y'] = CHAR_UPPER, ['Z'] = CHAR_UPPER,
+    ['_'] = CHAR_UPPER,
+    ['0'] = CHAR_NUMERAL, ['1'] = CHAR_NUMERAL, ['2'] = CHAR_NUMERAL, ['3'] = CHAR_NUMERAL, ['4'] = CHAR_NUMERAL,
+    ['5'] = CHAR_NUMERAL, ['6'] = CHAR_NUMERAL, ['7'] = CHAR_NUMERAL, ['8'] = CHAR_NUMERAL, ['9'] = CHAR_NUMERAL,
 };
-#define control_flow_count (sizeof(control_flow)/sizeof(control_flow[0]))
+
+#define char_is(x, class) (char_class[(uint8_t) (x)] & (class))
+
+#define KEYWORDS_TABLE_CAPACITY 1024
+#define KEYWORDS_MAX_LEN 32
+#define LANGUAGE_MAX_QUOTES 4
+
+typedef struct {
+    const char *text;
+    size_t text_len;
+    Token_Kind kind;
+} Keyword;
+
+typedef struct {
+    const char *open;
+    const char *close;
+    bool escapes;   // a backslash escapes the next byte. Before a newline it continues the string on the next line.
+    bool multiline; // the string goes on past the end of the line by itself
+} Quote;
+
+// What a token that begins with a byte may turn out to be
+enum {
+    START_BLOCK_COMMENT = 1 << 0,
+    START_LINE_COMMENT  = 1 << 1,
+    START_QUOTE         = 1 << 2,
+    START_PREPROC       = 1 << 3,
+    START_LITERAL       = 1 << 4,
+    START_SYMBOL        = 1 << 5,
+    START_NUMBER        = 1 << 6,
+};
+
+struct Language {
+    // The grammar
+    const char *name;
+    const char **extensions;   // NULL terminated, without the dot
+    const char **keywords;     // NULL terminated
+    const char **control_flow; // NULL terminated
+    const char *line_comment;
+    const char *block_comment_open;
+    const char *block_comment_close;
+    Quote quotes[LANGUAGE_MAX_QUOTES]; // a quote that is a prefix of another one has to come after it
+    bool preproc;              // # begins a directive that lasts until the end of the line
+    bool caps_are_macros;      // symbols in all caps are highlighted like directives
+    char digit_separator;
+
+    // Compiled from the grammar by lexer_init() before any of the languages is used.
+    // A token is told apart by its first byte with the starts table, and a symbol is classified
+    // by hashing it while it is being chopped and comparing it with at most one word.
+    bool ready;
+    uint8_t starts[256];
+    Keyword *entries; // [0] means empty slot
+    size_t entries_count;
+    uint16_t table[KEYWORDS_TABLE_CAPACITY];
+    uint32_t seed;
+};
+
+#define WORDS(...) ((const char *[]) {__VA_ARGS__, NULL})
+
+// The first one is what everything else is lexed as
+static Language languages[] = {
+    {
+        .name = "C",
+        .extensions = WORDS("c", "h", "cc", "cpp", "cxx", "hh", "hpp", "hxx", "inl"),
+        .keywords = WORDS(
+            "auto", "char", "const", "double", "enum", "extern", "float", "int", "long",
+            "register", "short", "signed", "sizeof", "static", "struct", "typedef", "union",
+            "unsigned", "void", "volatile", "while", "alignas", "alignof", "and", "and_eq",
+            "asm", "atomic_cancel", "atomic_commit", "atomic_noexcept", "bitand", "bitor",
+            "bool", "char16_t", "char32_t", "char8_t", "class", "compl", "concept", "const_cast",
+            "consteval", "constexpr", "constinit", "decltype", "delete", "dynamic_cast", "explicit",
+            "export", "false", "friend", "inline", "mutable", "namespace", "new", "noexcept", "not",
+            "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public",
+            "reflexpr", "reinterpret_cast", "requires", "static_assert", "static_cast", "synchronized",
+            "template", "this", "thread_local", "true", "typeid", "typename", "using", "virtual",
+            "wchar_t", "xor", "xor_eq"),
+        .control_flow = WORDS(
+            "break", "case", "continue", "default", "do", "else", "for", "goto", "if", "return",
+            "switch", "while", "catch", "co_await", "co_return", "co_yield", "try"),
+        .line_comment = "//",
+        .block_comment_open = "/*",
+        .block_comment_close = "*/",
+        .quotes = {
+            {.open = "\"", .close = "\"", .escapes = true},
+        },
+        .preproc = true,
+        .caps_are_macros = true,
+    },
+    {
+        .name = "Python",
+        .extensions = WORDS("py", "pyi", "pyw"),
+        .keywords = WORDS(
+            "False", "None", "True", "and", "as", "async", "await", "class", "def", "del",
+            "from", "global", "import", "in", "is", "lambda", "nonlocal", "not", "or", "pass",
+            "with"),
+        .control_flow = WORDS(
+            "break", "case", "continue", "elif", "else", "except", "finally", "for", "if",
+            "match", "raise", "return", "try", "while", "yield"),
+        .line_comment = "#",
+        .quotes = {
+            {.open = "\"\"\"", .close = "\"\"\"", .escapes = true, .multiline = true},
+            {.open = "'''", .close = "'''", .escapes = true, .multiline = true},
+            {.open = "\"", .close = "\"", .escapes = true},
+            {.open = "'", .close = "'", .escapes = true},
+        },
+        .digit_separator = '_',
+    },
+    {
+        .name = "Go",
+        .extensions = WORDS("go"),
+        .keywords = WORDS(
+            "chan", "const", "func", "import", "interface", "map", "package", "range", "struct",
+            "type", "var", "nil", "true", "false", "iota", "bool", "byte", "complex64",
+            "complex128", "error", "float32", "float64", "int", "int8", "int16", "int32", "int64",
+            "rune", "string", "uint", "uint8", "uint16", "uint32", "uint64", "uintptr", "any"),
+        .control_flow = WORDS(
+            "break", "case", "continue", "default", "defer", "else", "fallthrough", "for", "go",
+            "goto", "if", "return", "select", "switch"),
+        .line_comment = "//",
+        .block_comment_open = "/*",
+        .block_comment_close = "*/",
+        .quotes = {
+            {.open = "\"", .close = "\"", .escapes = true},
+            {.open = "`", .close = "`", .multiline = true},
+            {.open = "'", .close = "'", .escapes = true},
+        },
+        .digit_separator = '_',
+    },
+    {
+        .name = "Rust",
+        .extensions = WORDS("rs"),
+        .keywords = WORDS(
+            "as", "async", "await", "const", "crate", "dyn", "enum", "extern", "false", "fn",
+            "impl", "in", "let", "mod", "move", "mut", "pub", "ref", "self", "Self", "static",
+            "struct", "super", "trait", "true", "type", "union", "unsafe", "use", "where",
+            "bool", "char", "str", "i8", "i16", "i32", "i64", "i128", "isize", "u8", "u16",
+            "u32", "u64", "u128", "usize", "f32", "f64"),
+        .control_flow = WORDS(
+            "break", "continue", "else", "for", "if", "loop", "match", "return", "while", "yield"),
+        .line_comment = "//",
+        .block_comment_open = "/*",
+        .block_comment_close = "*/",
+        // NOTE: no character literals, a quote is just as likely to begin a lifetime
+        .quotes = {
+            {.open = "\"", .close = "\"", .escapes = true, .multiline = true},
+        },
+        .digit_separator = '_',
+    },
+    {
+        .name = "JSON",
+        .extensions = WORDS("json"),
+        .keywords = WORDS("true", "false", "null"),
+        .control_flow = WORDS(NULL),
+        .quotes = {
+            {.open = "\"", .close = "\"", .escapes = true},
+        },
+    },
+    {
+        .name = "Shell",
+        .extensions = WORDS("sh", "bash", "zsh"),
+        .keywords = WORDS(
+            "alias", "declare", "export", "function", "in", "local", "readonly", "set", "shift",
+            "source", "unset"),
+        .control_flow = WORDS(
+            "break", "case", "continue", "do", "done", "elif", "else", "esac", "exit", "fi",
+            "for", "if", "return", "select", "then", "until", "while"),
+        .line_comment = "#",
+        .quotes = {
+            {.open = "\"", .close = "\"", .escapes = true, .multiline = true},
+            {.open = "'", .close = "'", .multiline = true},
+        },
+    },
+};
+#define languages_count (sizeof(languages)/sizeof(languages[0]))
+
+// FNV-1a with the seed as the offset basis
+static inline uint32_t keyword_hash_step(uint32_t h, char x)
+{
+    return (h ^ (uint8_t) x)*16777619u;
+}
+
+static uint32_t keyword_hash(uint32_t seed, const char *text, size_t text_len)
+{
+    uint32_t h = seed;
+    for (size_t i = 0; i < text_len; ++i) h = keyword_hash_step(h, text[i]);
+    return h;
+}
+
+static void keywords_add(Language *lang, const char *text, Token_Kind kind)
+{
+    size_t text_len = strlen(text);
+    assert(text_len <= KEYWORDS_MAX_LEN);
+    // NOTE: a word may be both a keyword and control flow ("while"), the later one wins
+    for (size_t i = 1; i < lang->entries_count; ++i) {
+        if (strcmp(lang->entries[i].text, text) == 0) {
+            lang->entries[i].kind = kind;
+            return;
+        }
+    }
+    lang->entries[lang->entries_count++] = (Keyword) {
+        .text = text,
+        .text_len = text_len,
+        .kind = kind,
+    };
+}
+
+static bool keywords_try_seed(Language *lang, uint32_t seed)
+{
+    memset(lang->table, 0, sizeof(lang->table));
+    for (size_t i = 1; i < lang->entries_count; ++i) {
+        Keyword *k = &lang->entries[i];
+        uint32_t slot = keyword_hash(seed, k->text, k->text_len) & (KEYWORDS_TABLE_CAPACITY - 1);
+        if (lang->table[slot] != 0) return false;
+        lang->table[slot] = (uint16_t) i;
+    }
+    return true;
+}
+
+static size_t words_count(const char **words)
+{
+    size_t count = 0;
+    while (words[count] != NULL) count += 1;
+    return count;
+}
+
+static void language_compile(Language *lang)
+{
+    size_t capacity = 1 + words_count(lang->keywords) + words_count(lang->control_flow);
+    assert(capacity < KEYWORDS_TABLE_CAPACITY);
+    lang->entries = malloc(capacity*sizeof(*lang->entries));
+    assert(lang->entries != NULL && "Buy more RAM lol");
+    memset(&lang->entries[0], 0, sizeof(lang->entries[0]));
+    lang->entries_count = 1;
+    for (const char **w = lang->keywords; *w != NULL; ++w) keywords_add(lang, *w, TOKEN_KEYWORD);
+    for (const char **w = lang->control_flow; *w != NULL; ++w) keywords_add(lang, *w, TOKEN_CONTROL_FLOW);
+
+    lang->seed = 2166136261u;
+    while (!keywords_try_seed(lang, lang->seed)) lang->seed += 1;
+
+    memset(lang->starts, 0, sizeof(lang->starts));
+    if (lang->block_comment_open) lang->starts[(uint8_t) lang->block_comment_open[0]] |= START_BLOCK_COMMENT;
+    if (lang->line_comment) lang->starts[(uint8_t) lang->line_comment[0]] |= START_LINE_COMMENT;
+    for (size_t i = 0; i < LANGUAGE_MAX_QUOTES && lang->quotes[i].open; ++i) {
+        lang->starts[(uint8_t) lang->quotes[i].open[0]] |= START_QUOTE;
+    }
+    if (lang->preproc) lang->starts['#'] |= START_PREPROC;
+    for (size_t i = 0; i < literal_tokens_count; ++i) {
+        lang->starts[(uint8_t) literal_tokens[i].text[0]] |= START_LITERAL;
+    }
+    for (size_t x = 0; x < 256; ++x) {
+        if (char_is(x, CHAR_SYMBOL_START)) lang->starts[x] |= START_SYMBOL;
+        if (char_is(x, CHAR_DIGIT)) lang->starts[x] |= START_NUMBER;
+    }
+
+    lang->ready = true;
+}
+
+// Kind of the symbol text with the given hash. TOKEN_SYMBOL if it is not a word of the language.
+static Token_Kind keywords_classify(const Language *lang, uint32_t hash, const char *text, size_t text_len)
+{
+    const Keyword *k = &lang->entries[lang->table[hash & (KEYWORDS_TABLE_CAPACITY - 1)]];
+    if (k->text_len == text_len && memcmp(k->text, text, text_len) == 0) return k->kind;
+    return TOKEN_SYMBOL;
+}
+
+void lexer_init(void)
+{
+    for (size_t i = 0; i < languages_count; ++i) {
+        if (!languages[i].ready) language_compile(&languages[i]);
+    }
+}
+
+const Language *language_by_path(const char *file_path)
+{
+    lexer_init();
+    const char *extension = strrchr(file_path, '.');
+    const char *slash = strrchr(file_path, '/');
+    if (extension != NULL && (slash == NULL || extension > slash)) {
+        extension += 1;
+        for (size_t i = 0; i < languages_count; ++i) {
+            for (const char **e = languages[i].extensions; *e != NULL; ++e) {
+                if (strcmp(*e, extension) == 0) return &languages[i];
+            }
+        }
+    }
+    return &languages[0];
+}
+
+const char *language_name(const Language *lang)
+{
+    return lang->name;
+}
 
 const char *token_kind_name(Token_Kind kind)
 {
@@ -70,6 +369,8 @@ const char *token_kind_name(Token_Kind kind)
         return "comment";
     case TOKEN_STRING:
         return "string";
+    case TOKEN_NUMBER:
+        return "number";
     }
 }
 
@@ -90,29 +391,65 @@ Vec4f token_kind_color(Token_Kind kind)
     case TOKEN_CONTROL_FLOW: return hex_to_vec4f(0xCC8C3CFF);
     case TOKEN_COMMENT: return hex_to_vec4f(0x95A99FFF);
     case TOKEN_STRING: return hex_to_vec4f(0x73c936ff);
+    case TOKEN_NUMBER: return hex_to_vec4f(0x9E95C7FF);
     }
 }
 
-Lexer lexer_new(Free_Glyph_Atlas *atlas, const char *content, size_t content_len)
+Lexer lexer_new(const Buffer *content, const Language *language)
 {
+    const Language *lang = language ? language : &languages[0];
+    assert(lang->ready && "lexer_init() was not called");
+
     Lexer l = {0};
-    l.atlas = atlas;
     l.content = content;
-    l.content_len = content_len;
+    l.language = lang;
     return l;
 }
 
+Lexer lexer_new_at_line(const Buffer *content, const Language *language, size_t bol, size_t line, Lexer_State state)
+{
+    Lexer l = lexer_new(content, language);
+    l.cursor = bol;
+    l.bol = bol;
+    l.line = line;
+    l.state = state;
+    return l;
+}
+
+// Returns the byte at l->cursor + offset, or '\0' past the end of the content.
+// The lexer walks the content mostly forward, so the current contiguous chunk
+// of the buffer is cached and only refetched when we step out of it.
+static char lexer_peek(Lexer *l, size_t offset)
+{
+    size_t pos = l->cursor + offset;
+    if (pos >= l->content->count) return '\0';
+    if (pos < l->chunk_begin || pos - l->chunk_begin >= l->chunk.count) {
+        l->chunk_begin = pos;
+        l->chunk = buffer_chunk(l->content, pos);
+    }
+    return l->chunk.data[pos - l->chunk_begin];
+}
+
+// The bytes from the cursor to the end of its chunk. Empty at the end of the content.
+static String_View lexer_rest(Lexer *l)
+{
+    if (l->cursor >= l->content->count) return sv_from_parts(NULL, 0);
+    lexer_peek(l, 0);
+    size_t offset = l->cursor - l->chunk_begin;
+    return sv_from_parts(l->chunk.data + offset, l->chunk.count - offset);
+}
+
 bool lexer_starts_with(Lexer *l, const char *prefix)
 {
     size_t prefix_len = strlen(prefix);
     if (prefix_len == 0) {
         return true;
     }
-    if (l->cursor + prefix_len - 1 >= l->content_len) {
+    if (l->cursor + prefix_len - 1 >= l->content->count) {
         return false;
     }
     for (size_t i = 0; i < prefix_len; ++i) {
-        if (prefix[i] != l->content[l->cursor + i]) {
+        if (prefix[i] != lexer_peek(l, i)) {
             return false;
         }
     }
@@ -123,147 +460,269 @@ void lexer_chop_char(Lexer *l, size_t len)
 {
     for (size_t i = 0; i < len; ++i) {
         // TODO: get rid of this assert by checking the length of the choped prefix upfront
-        assert(l->cursor < l->content_len);
-        char x = l->content[l->cursor];
+        assert(l->cursor < l->content->count);
+        char x = lexer_peek(l, 0);
         l->cursor += 1;
         if (x == '\n') {
             l->line += 1;
             l->bol = l->cursor;
-            l->x = 0;
-        } else {
-            if (l->atlas) {
-                size_t glyph_index = x;
-                // TODO: support for glyphs outside of ASCII range
-                if (glyph_index >= GLYPH_METRICS_CAPACITY) {
-                    glyph_index = '?';
-                }
-                Glyph_Metric metric = l->atlas->metrics[glyph_index];
-                l->x += metric.ax;
-            }
         }
     }
 }
 
+// Skips to the first of a, b or c, or to the end of the content, and returns the byte it
+// stopped at. One of them must be a newline, since the skipped bytes are not counted as lines.
+static char lexer_skip_until(Lexer *l, char a, char b, char c)
+{
+    for (;;) {
+        String_View rest = lexer_rest(l);
+        if (rest.count == 0) return '\0';
+        size_t n = scan_until3(rest.data, rest.count, a, b, c);
+        l->cursor += n;
+        if (n < rest.count) return rest.data[n];
+    }
+}
+
 void lexer_trim_left(Lexer *l)
 {
-    while (l->cursor < l->content_len && isspace(l->content[l->cursor])) {
+    for (;;) {
+        String_View rest = lexer_rest(l);
+        if (rest.count == 0) return;
+        size_t n = scan_blanks(rest.data, rest.count);
+        l->cursor += n;
+        if (n < rest.count) {
+            if (!char_is(rest.data[n], CHAR_SPACE)) return;
+            lexer_chop_char(l, 1);
+        }
+    }
+}
+
+// Chops the rest of the string up to and including the closing quote. A string that is not
+// multiline ends at the newline, unless there is a backslash right before it.
+static void lexer_chop_string(Lexer *l, size_t index)
+{
+    const Quote *q = &l->language->quotes[index];
+    size_t close_len = strlen(q->close);
+    l->state = LEXER_STATE_NORMAL;
+    for (;;) {
+        char x = lexer_skip_until(l, q->close[0], q->escapes ? '\\' : '\n', '\n');
+        if (l->cursor >= l->content->count) return;
+        if (x == '\n') {
+            lexer_chop_char(l, 1);
+            if (q->multiline) l->state = LEXER_STATE_STRING + index;
+            return;
+        }
+        if (x == q->close[0] && lexer_starts_with(l, q->close)) {
+            lexer_chop_char(l, close_len);
+            return;
+        }
+        if (x != '\\' || !q->escapes) {
+            lexer_chop_char(l, 1);
+            continue;
+        }
+        if (lexer_peek(l, 1) == '\n') {
+            lexer_chop_char(l, 2);
+            l->state = LEXER_STATE_STRING + index;
+            return;
+        }
+        lexer_chop_char(l, l->cursor + 1 < l->content->count ? 2 : 1);
+    }
+}
+
+// Chops the directive up to and including the newline. A backslash right before
+// the newline continues the directive on the next line.
+static void lexer_chop_preproc(Lexer *l)
+{
+    l->state = LEXER_STATE_NORMAL;
+    for (;;) {
+        char x = lexer_skip_until(l, '\\', '\n', '\n');
+        if (l->cursor >= l->content->count) return;
+        if (x == '\n') {
+            lexer_chop_char(l, 1);
+            return;
+        }
+        if (lexer_peek(l, 1) == '\n') {
+            lexer_chop_char(l, 2);
+            l->state = LEXER_STATE_PREPROC;
+            return;
+        }
         lexer_chop_char(l, 1);
     }
 }
 
-bool is_symbol_start(char x)
+// Chops the block comment up to and including its end or the end of the line, whatever comes first
+static void lexer_chop_block_comment(Lexer *l)
 {
-    return isalpha(x) || x == '_';
+    const char *close = l->language->block_comment_close;
+    l->state = LEXER_STATE_COMMENT;
+    for (;;) {
+        char x = lexer_skip_until(l, close[0], '\n', '\n');
+        if (l->cursor >= l->content->count) return;
+        if (x == '\n') {
+            lexer_chop_char(l, 1);
+            return;
+        }
+        if (lexer_starts_with(l, close)) {
+            lexer_chop_char(l, strlen(close));
+            l->state = LEXER_STATE_NORMAL;
+            return;
+        }
+        lexer_chop_char(l, 1);
+    }
 }
 
-bool is_symbol(char x)
+// Chops a number with its base prefix, fraction, exponent and suffix
+static void lexer_chop_number(Lexer *l)
 {
-    return isalnum(x) || x == '_';
+    char separator = l->language->digit_separator;
+    bool hex = lexer_peek(l, 0) == '0' && (lexer_peek(l, 1) == 'x' || lexer_peek(l, 1) == 'X');
+    char prev = '\0';
+    for (;;) {
+        char x = lexer_peek(l, 0);
+        bool sign = (x == '+' || x == '-') && !hex && (prev == 'e' || prev == 'E');
+        if (!char_is(x, CHAR_SYMBOL) && x != '.' && !sign && (x != separator || separator == '\0')) return;
+        l->cursor += 1;
+        prev = x;
+    }
 }
 
 Token lexer_next(Lexer *l)
 {
-    lexer_trim_left(l);
+    const Language *lang = l->language;
+    if (l->state == LEXER_STATE_NORMAL) lexer_trim_left(l);
 
     Token token = {
-        .text = &l->content[l->cursor],
+        .begin = l->cursor,
     };
 
-    token.position.x = l->x;
-    token.position.y = -(float)l->line * FREE_GLYPH_FONT_SIZE;
+    if (l->cursor >= l->content->count) return token;
 
-    if (l->cursor >= l->content_len) return token;
-
-    if (l->content[l->cursor] == '"') {
-        // TODO: TOKEN_STRING should also handle escape sequences
+    switch (l->state) {
+    case LEXER_STATE_NORMAL:
+        break;
+    case LEXER_STATE_COMMENT:
+        token.kind = TOKEN_COMMENT;
+        lexer_chop_block_comment(l);
+        token.text_len = l->cursor - token.begin;
+        return token;
+    case LEXER_STATE_PREPROC:
+        token.kind = TOKEN_PREPROC;
+        lexer_chop_preproc(l);
+        token.text_len = l->cursor - token.begin;
+        return token;
+    default:
+        assert(l->state - LEXER_STATE_STRING < LANGUAGE_MAX_QUOTES);
         token.kind = TOKEN_STRING;
-        lexer_chop_char(l, 1);
-        while (l->cursor < l->content_len && l->content[l->cursor] != '"' && l->content[l->cursor] != '\n') {
-            lexer_chop_char(l, 1);
-        }
-        if (l->cursor < l->content_len) {
-            lexer_chop_char(l, 1);
-        }
-        token.text_len = &l->content[l->cursor] - token.text;
+        lexer_chop_string(l, l->state - LEXER_STATE_STRING);
+        token.text_len = l->cursor - token.begin;
         return token;
     }
 
-    if (l->content[l->cursor] == '#') {
-        // TODO: preproc should also handle newlines
-        token.kind = TOKEN_PREPROC;
-        while (l->cursor < l->content_len && l->content[l->cursor] != '\n') {
-            lexer_chop_char(l, 1);
-        }
-        if (l->cursor < l->content_len) {
-            lexer_chop_char(l, 1);
-        }
-        token.text_len = &l->content[l->cursor] - token.text;
+    char first = lexer_peek(l, 0);
+    uint8_t starts = lang->starts[(uint8_t) first];
+
+    if ((starts & START_BLOCK_COMMENT) && lexer_starts_with(l, lang->block_comment_open)) {
+        token.kind = TOKEN_COMMENT;
+        lexer_chop_char(l, strlen(lang->block_comment_open));
+        lexer_chop_block_comment(l);
+        token.text_len = l->cursor - token.begin;
         return token;
     }
 
-    if (lexer_starts_with(l, "//")) {
+    if ((starts & START_LINE_COMMENT) && lexer_starts_with(l, lang->line_comment)) {
         token.kind = TOKEN_COMMENT;
-        while (l->cursor < l->content_len && l->content[l->cursor] != '\n') {
-            lexer_chop_char(l, 1);
-        }
-        if (l->cursor < l->content_len) {
+        lexer_skip_until(l, '\n', '\n', '\n');
+        if (l->cursor < l->content->count) {
             lexer_chop_char(l, 1);
         }
-        token.text_len = &l->content[l->cursor] - token.text;
+        token.text_len = l->cursor - token.begin;
         return token;
     }
-    
-    for (size_t i = 0; i < literal_tokens_count; ++i) {
-        if (lexer_starts_with(l, literal_tokens[i].text)) {
-            // NOTE: this code assumes that there is no newlines in literal_tokens[i].text
-            size_t text_len = strlen(literal_tokens[i].text);
-            token.kind = literal_tokens[i].kind;
-            token.text_len = text_len;
-            lexer_chop_char(l, text_len);
-            return token;
+
+    if (starts & START_QUOTE) {
+        for (size_t i = 0; i < LANGUAGE_MAX_QUOTES && lang->quotes[i].open; ++i) {
+            const char *open = lang->quotes[i].open;
+            if (open[0] == first && lexer_starts_with(l, open)) {
+                token.kind = TOKEN_STRING;
+                lexer_chop_char(l, strlen(open));
+                lexer_chop_string(l, i);
+                token.text_len = l->cursor - token.begin;
+                return token;
+            }
         }
     }
 
-    if (is_symbol_start(l->content[l->cursor])) {
-        token.kind = TOKEN_SYMBOL;
-        while (l->cursor < l->content_len && is_symbol(l->content[l->cursor])) {
-            lexer_chop_char(l, 1);
-            token.text_len += 1;
-        }
+    if (starts & START_PREPROC) {
+        token.kind = TOKEN_PREPROC;
+        lexer_chop_preproc(l);
+        token.text_len = l->cursor - token.begin;
+        return token;
+    }
 
-        for (size_t i = 0; i < keywords_count; ++i) {
-            size_t keyword_len = strlen(keywords[i]);
-            if (keyword_len == token.text_len && memcmp(keywords[i], token.text, keyword_len) == 0) {
-                token.kind = TOKEN_KEYWORD;
-                break;
+    if (starts & START_LITERAL) {
+        for (size_t i = 0; i < literal_tokens_count; ++i) {
+            if (literal_tokens[i].text[0] == first && lexer_starts_with(l, literal_tokens[i].text)) {
+                // NOTE: this code assumes that there is no newlines in literal_tokens[i].text
+                size_t text_len = strlen(literal_tokens[i].text);
+                token.kind = literal_tokens[i].kind;
+                token.text_len = text_len;
+                lexer_chop_char(l, text_len);
+                return token;
             }
         }
+    }
 
-        for (size_t i = 0; i < control_flow_count; ++i) {
-            size_t control_flow_len = strlen(control_flow[i]);
-            if (control_flow_len == token.text_len && memcmp(control_flow[i], token.text, control_flow_len) == 0) {
-                token.kind = TOKEN_CONTROL_FLOW;
-                break;
+    if (starts & START_SYMBOL) {
+        token.kind = TOKEN_SYMBOL;
+
+        // NOTE: the bytes are classified and hashed in the same pass that chops them
+        uint32_t hash = lang->seed;
+        uint8_t classes = CHAR_CAPS;
+        const char *text = NULL; // the symbol when it lies within a single chunk of the buffer
+        for (;;) {
+            String_View rest = lexer_rest(l);
+            size_t n = 0;
+            while (n < rest.count) {
+                uint8_t class = char_class[(uint8_t) rest.data[n]];
+                if (!(class & CHAR_SYMBOL)) break;
+                classes &= class;
+                hash = keyword_hash_step(hash, rest.data[n]);
+                n += 1;
+            }
+            if (token.text_len == 0) {
+                text = rest.data;
+            } else if (n > 0) {
+                text = NULL;
             }
+            l->cursor += n;
+            token.text_len += n;
+            if (n < rest.count || rest.count == 0) break;
         }
 
-        bool all_caps = true;
-        for (size_t i = 0; i < token.text_len; i++) {
-            switch (token.text[i]) {
-                case 'A'...'Z':
-                case '0'...'9':
-                case '_':
-                    break;
-                default: all_caps = false;
+        if (token.text_len <= KEYWORDS_MAX_LEN) {
+            char copy[KEYWORDS_MAX_LEN];
+            if (text == NULL) {
+                // NOTE: the symbol straddles two chunks, which is rare enough to just copy it
+                for (size_t i = 0; i < token.text_len; ++i) copy[i] = buffer_at(l->content, token.begin + i);
+                text = copy;
             }
+            token.kind = keywords_classify(lang, hash, text, token.text_len);
         }
-        if (all_caps && token.text_len > 1) {
+
+        if (lang->caps_are_macros && (classes & CHAR_CAPS) && token.text_len > 1) {
             token.kind = TOKEN_PREPROC;
         }
 
         return token;
     }
 
+    if (starts & START_NUMBER) {
+        token.kind = TOKEN_NUMBER;
+        lexer_chop_number(l);
+        token.text_len = l->cursor - token.begin;
+        return token;
+    }
+
     lexer_chop_char(l, 1);
     token.kind = TOKEN_INVALID;
     token.text_len = 1;
@@ -3,7 +3,7 @@
 
 #include <stddef.h>
 #include "./la.h"
-#include "./free_glyph.h"
+#include "./buffer.h"
 
 typedef enum {
     TOKEN_END = 0,
@@ -19,29 +19,53 @@ typedef enum {
     TOKEN_CONTROL_FLOW,
     TOKEN_COMMENT,
     TOKEN_STRING,
+    TOKEN_NUMBER,
 } Token_Kind;
 
 const char *token_kind_name(Token_Kind kind);
 Vec4f token_kind_color(Token_Kind kind);
 
+// Tokens only refer to the content by offsets. Where they end up on the screen is up to the renderer.
 typedef struct {
     Token_Kind kind;
-    const char *text;
+    size_t begin;
     size_t text_len;
-    Vec2f position;
 } Token;
 
+// What the lexer is in the middle of at the beginning of a line. Tokens never
+// span several lines, the constructs that do are split into a token per line.
+typedef enum {
+    LEXER_STATE_NORMAL = 0,
+    LEXER_STATE_COMMENT, // inside of /* */
+    LEXER_STATE_PREPROC, // the previous line of the directive ended with a backslash
+    LEXER_STATE_STRING,  // the string goes on from the previous line. Plus the index of its quote in the language.
+} Lexer_State;
+
+// The grammar a buffer is lexed with: its keywords, comments, quotes and numbers. See languages in lexer.c.
+typedef struct Language Language;
+
+// Compiles the grammars of all the languages. Call it on the main thread before anything is
+// lexed, calling it again does nothing. Every language that language_by_path() returns is compiled.
+void lexer_init(void);
+// Picks the language by the extension of the file. Everything unknown is lexed as C.
+const Language *language_by_path(const char *file_path);
+const char *language_name(const Language *language);
+
 typedef struct {
-    Free_Glyph_Atlas *atlas;
-    const char *content;
-    size_t content_len;
+    const Buffer *content;
+    const Language *language;
+    String_View chunk;
+    size_t chunk_begin;
     size_t cursor;
     size_t line;
     size_t bol;
-    float x;
+    Lexer_State state;
 } Lexer;
 
-Lexer lexer_new(Free_Glyph_Atlas *atlas, const char *content, size_t content_len);
+// A NULL language lexes C
+Lexer lexer_new(const Buffer *content, const Language *language);
+// Starts lexing at the beginning of a line that the lexer entered in the given state.
+Lexer lexer_new_at_line(const Buffer *content, const Language *language, size_t bol, size_t line, Lexer_State state);
 Token lexer_next(Lexer *l);
 
 #endif // LEXER_H_
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "./common.h"
+#include "./lexer.h"
+#include "./scan.h"
+
+// The file is lexed over and over until this many bytes went through the lexer
+#define BENCH_BYTES_MIN (256*1024*1024)
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+        fprintf(stderr, "Lexes the file with the language of its extension and prints the throughput\n");
+        return 1;
+    }
+    const char *file_path = argv[1];
+
+    Buffer b = {0};
+    Errno err = buffer_load_from_file(&b, file_path);
+    if (err != 0) {
+        fprintf(stderr, "ERROR: Could not read file %s: %s\n", file_path, strerror(err));
+        return 1;
+    }
+    if (b.count == 0) {
+        fprintf(stderr, "ERROR: %s is empty\n", file_path);
+        return 1;
+    }
+
+    scan_init();
+    const Language *language = language_by_path(file_path);
+    size_t passes = (BENCH_BYTES_MIN + b.count - 1)/b.count;
+    size_t tokens = 0;
+    size_t symbols = 0;
+    clock_t begin = clock();
+    for (size_t pass = 0; pass < passes; ++pass) {
+        Lexer l = lexer_new(&b, language);
+        Token t = lexer_next(&l);
+        while (t.kind != TOKEN_END) {
+            tokens += 1;
+            if (t.kind == TOKEN_SYMBOL || t.kind == TOKEN_KEYWORD || t.kind == TOKEN_CONTROL_FLOW) symbols += 1;
+            t = lexer_next(&l);
+        }
+    }
+    double secs = (double) (clock() - begin)/CLOCKS_PER_SEC;
+
+    printf("%s: %zu bytes of %s, %zu tokens, %zu words\n", file_path, b.count, language_name(language), tokens/passes, symbols/passes);
+    printf("%.1f MB/s\n", (double) b.count*passes/secs/1e6);
+
+    buffer_clear(&b);
+    free(b.pieces.items);
+    return 0;
+}
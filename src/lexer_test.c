@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+// NOTE: the word lists of the languages are private to lexer.c, every word of them is checked
+#include "./lexer.c"
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures += 1;
+    }
+}
+
+static bool words_contain(const char **words, const char *word)
+{
+    for (; *words != NULL; ++words) {
+        if (strcmp(*words, word) == 0) return true;
+    }
+    return false;
+}
+
+// What lexer_next() classified symbols as before the perfect hash: the keywords were compared
+// first, then control flow which wins for the words in both lists, then the caps.
+static Token_Kind classify_slowly(const Language *lang, const char *text)
+{
+    Token_Kind kind = TOKEN_SYMBOL;
+    if (words_contain(lang->keywords, text)) kind = TOKEN_KEYWORD;
+    if (words_contain(lang->control_flow, text)) kind = TOKEN_CONTROL_FLOW;
+
+    size_t text_len = strlen(text);
+    bool caps = true;
+    for (size_t i = 0; i < text_len; ++i) {
+        if (!(text[i] >= 'A' && text[i] <= 'Z') && !(text[i] >= '0' && text[i] <= '9') && text[i] != '_') caps = false;
+    }
+    if (lang->caps_are_macros && caps && text_len > 1) kind = TOKEN_PREPROC;
+    return kind;
+}
+
+// The buffer holds the text in pieces split at every offset in splits
+static void buffer_from_pieces(Buffer *b, const char *text, const size_t *splits, size_t splits_count)
+{
+    buffer_clear(b);
+    size_t text_len = strlen(text);
+    // NOTE: inserting the pieces back to front keeps any two of them from being adjacent in memory
+    size_t end = text_len;
+    for (size_t i = splits_count; i > 0; --i) {
+        buffer_insert(b, 0, text + splits[i - 1], end - splits[i - 1]);
+        end = splits[i - 1];
+    }
+    buffer_insert(b, 0, text, end);
+}
+
+// Lexes "(word)" with the word cut into two pieces at split, or not at all if split is 0
+static void expect_word(const Language *lang, const char *word, size_t split)
+{
+    char text[KEYWORDS_MAX_LEN*2 + 8];
+    snprintf(text, sizeof(text), "(%s)", word);
+    size_t splits[] = {split + 1};
+    Buffer b = {0};
+    buffer_from_pieces(&b, text, splits, split > 0 ? 1 : 0);
+    expect(split == 0 || b.pieces.count > 1, "the text is split into pieces");
+
+    Lexer l = lexer_new(&b, lang);
+    Token open = lexer_next(&l);
+    Token symbol = lexer_next(&l);
+    Token close = lexer_next(&l);
+    Token end = lexer_next(&l);
+    bool ok = open.kind == TOKEN_OPEN_PAREN
+        && symbol.begin == 1 && symbol.text_len == strlen(word)
+        && symbol.kind == classify_slowly(lang, word)
+        && close.kind == TOKEN_CLOSE_PAREN
+        && end.kind == TOKEN_END;
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s classifies `%s` split at %zu as %s\n", lang->name, word, split, token_kind_name(symbol.kind));
+        failures += 1;
+    }
+
+    buffer_clear(&b);
+    free(b.pieces.items);
+}
+
+static void test_words(const Language *lang, const char **words)
+{
+    for (; *words != NULL; ++words) {
+        char word[KEYWORDS_MAX_LEN + 2];
+        size_t word_len = strlen(*words);
+        for (size_t split = 0; split < word_len; ++split) {
+            expect_word(lang, *words, split);
+        }
+        // The words next to it differ in a byte, so they have to be compared and not just hashed
+        snprintf(word, sizeof(word), "%sx", *words);
+        expect_word(lang, word, word_len);
+        snprintf(word, sizeof(word), "%.*s", (int) word_len - 1, *words);
+        if (word_len > 1) expect_word(lang, word, 0);
+    }
+}
+
+static void test_languages(void)
+{
+    for (size_t i = 0; i < languages_count; ++i) {
+        char path[32];
+        snprintf(path, sizeof(path), "file.%s", languages[i].extensions[0]);
+        const Language *lang = language_by_path(path);
+        expect(lang == &languages[i], "the language is picked by its extension");
+        test_words(lang, lang->keywords);
+        test_words(lang, lang->control_flow);
+        test_words(lang, WORDS("FOO", "FOO_BAR", "X11", "A", "_", "Foo", "foo_BAR", "uint8_t", "WHILE"));
+    }
+}
+
+static void test_while(void)
+{
+    const Language *c = language_by_path("main.c");
+    Buffer b = {0};
+    const char *text = "while";
+    buffer_insert(&b, 0, text, strlen(text));
+    Lexer l = lexer_new(&b, c);
+    expect(lexer_next(&l).kind == TOKEN_CONTROL_FLOW, "`while` is control flow in C even though it is a keyword too");
+    buffer_clear(&b);
+    free(b.pieces.items);
+}
+
+// The token stream of a snippet of C cut into pieces of 1 to 7 bytes matches the one of the whole
+static void test_stream(void)
+{
+    const char *text =
+        "#include <stdio.h>\n"
+        "#define MAX_SIZE 1024\n"
+        "static int counter_value = 0; /* counts\n"
+        "   things */\n"
+        "int main(void) {\n"
+        "    while (counter_value < MAX_SIZE) counter_value += 1; // done\n"
+        "    if (NULL == X11_DISPLAY) return \"a\\\"b\";\n"
+        "    do_something_with_a_very_long_name_that_is_past_the_keywords(ULLONG_MAX);\n"
+        "}\n";
+    const Language *c = language_by_path("main.c");
+
+    Buffer whole = {0};
+    buffer_insert(&whole, 0, text, strlen(text));
+
+    size_t splits[256];
+    size_t splits_count = 0;
+    for (size_t pos = 1 + rand()%7; pos < strlen(text); pos += 1 + rand()%7) {
+        assert(splits_count < sizeof(splits)/sizeof(splits[0]));
+        splits[splits_count++] = pos;
+    }
+    Buffer split = {0};
+    buffer_from_pieces(&split, text, splits, splits_count);
+    expect(split.pieces.count > 1, "the text is split into pieces");
+
+    struct {
+        const char *text;
+        Token_Kind kind;
+    } expected[] = {
+        {"MAX_SIZE)", TOKEN_PREPROC},
+        {"static", TOKEN_KEYWORD},
+        {"counter_value =", TOKEN_SYMBOL},
+        {"while", TOKEN_CONTROL_FLOW},
+        {"NULL", TOKEN_PREPROC},
+        {"X11_DISPLAY", TOKEN_PREPROC},
+        {"return", TOKEN_CONTROL_FLOW},
+        {"do_something", TOKEN_SYMBOL},
+        {"ULLONG_MAX", TOKEN_PREPROC},
+    };
+    size_t expected_count = sizeof(expected)/sizeof(expected[0]);
+    size_t expected_found = 0;
+
+    Lexer a = lexer_new(&whole, c);
+    Lexer b = lexer_new(&split, c);
+    size_t tokens = 0;
+    for (;;) {
+        Token x = lexer_next(&a);
+        Token y = lexer_next(&b);
+        if (x.kind != y.kind || x.begin != y.begin || x.text_len != y.text_len) {
+            fprintf(stderr, "FAILED: token %zu at %zu is %s in one piece and %s at %zu in pieces\n",
+                    tokens, x.begin, token_kind_name(x.kind), token_kind_name(y.kind), y.begin);
+            failures += 1;
+            break;
+        }
+        if (x.kind == TOKEN_END) break;
+        for (size_t i = 0; i < expected_count; ++i) {
+            if (x.begin == (size_t) (strstr(text, expected[i].text) - text)) {
+                expect(x.kind == expected[i].kind, "the symbols of the snippet are classified");
+                expected_found += 1;
+            }
+        }
+        tokens += 1;
+    }
+    expect(tokens == 44, "the snippet is lexed into every token");
+    expect(expected_found == expected_count, "the symbols of the snippet are lexed as tokens");
+
+    buffer_clear(&whole);
+    free(whole.pieces.items);
+    buffer_clear(&split);
+    free(split.pieces.items);
+}
+
+int main(void)
+{
+    scan_init();
+    test_languages();
+    test_while();
+    for (int i = 0; i < 100; ++i) test_stream();
+    if (failures > 0) return 1;
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,524 @@
+#include <assert.h>
+#include <string.h>
+#include "./lines.h"
+#include "./scan.h"
+
+#include <SDL2/SDL.h>
+
+#define NODE(id) (lines->nodes.items[(id)])
+
+static uint32_t lines_random(Lines *lines)
+{
+    // xorshift32
+    uint32_t x = lines->seed ? lines->seed : 0x9E3779B9;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    lines->seed = x;
+    return x;
+}
+
+static void lines_update(Lines *lines, uint32_t id)
+{
+    Line_Node *n = &NODE(id);
+    n->size = 1 + NODE(n->left).size + NODE(n->right).size;
+    n->sum = n->length + NODE(n->left).sum + NODE(n->right).sum;
+}
+
+static void lines_node_init(Lines *lines, uint32_t id, size_t length)
+{
+    NODE(id) = (Line_Node) {
+        .priority = lines_random(lines),
+        .size = 1,
+        .length = length,
+        .sum = length,
+    };
+}
+
+static uint32_t lines_alloc(Lines *lines, size_t length)
+{
+    if (lines->nodes.count == 0) {
+        Line_Node nil = {0};
+        da_append(&lines->nodes, nil);
+    }
+
+    uint32_t id;
+    if (lines->free_list != 0) {
+        id = lines->free_list;
+        lines->free_list = NODE(id).left;
+    } else {
+        assert(lines->nodes.count < UINT32_MAX);
+        id = (uint32_t) lines->nodes.count;
+        Line_Node node = {0};
+        da_append(&lines->nodes, node);
+    }
+    lines_node_init(lines, id, length);
+    return id;
+}
+
+static void lines_free(Lines *lines, uint32_t id)
+{
+    if (id == 0) return;
+    lines_free(lines, NODE(id).left);
+    lines_free(lines, NODE(id).right);
+    NODE(id).left = lines->free_list;
+    lines->free_list = id;
+}
+
+// Splits the tree t into the first k rows and the rest
+static void lines_split(Lines *lines, uint32_t t, size_t k, uint32_t *l, uint32_t *r)
+{
+    if (t == 0) {
+        *l = 0;
+        *r = 0;
+        return;
+    }
+
+    size_t left_size = NODE(NODE(t).left).size;
+    if (k <= left_size) {
+        lines_split(lines, NODE(t).left, k, l, &NODE(t).left);
+        *r = t;
+    } else {
+        lines_split(lines, NODE(t).right, k - left_size - 1, &NODE(t).right, r);
+        *l = t;
+    }
+    lines_update(lines, t);
+}
+
+static uint32_t lines_merge(Lines *lines, uint32_t a, uint32_t b)
+{
+    if (a == 0) return b;
+    if (b == 0) return a;
+
+    if (NODE(a).priority > NODE(b).priority) {
+        NODE(a).right = lines_merge(lines, NODE(a).right, b);
+        lines_update(lines, a);
+        return a;
+    } else {
+        NODE(b).left = lines_merge(lines, a, NODE(b).left);
+        lines_update(lines, b);
+        return b;
+    }
+}
+
+// Builds a treap out of lines pushed in order in O(n). The right spine of the
+// tree is kept on the stack, and every node that is popped off is complete.
+static void lines_build_push(Lines *lines, uint32_t id)
+{
+    uint32_t last = 0;
+    while (lines->stack.count > 0 && NODE(da_last(&lines->stack)).priority < NODE(id).priority) {
+        last = lines->stack.items[--lines->stack.count];
+        lines_update(lines, last);
+    }
+    NODE(id).left = last;
+    if (lines->stack.count > 0) NODE(da_last(&lines->stack)).right = id;
+    da_append(&lines->stack, id);
+}
+
+static uint32_t lines_build_end(Lines *lines)
+{
+    uint32_t root = 0;
+    while (lines->stack.count > 0) {
+        root = lines->stack.items[--lines->stack.count];
+        lines_update(lines, root);
+    }
+    return root;
+}
+
+// Pushes the lines of bytes [begin, end) of the buffer. The last one gets its
+// newline counted only if there is one right at end.
+static void lines_scan(Lines *lines, const Buffer *buffer, size_t begin, size_t end, bool newline_at_end)
+{
+    uint32_t newlines[SCAN_BLOCK_SIZE];
+    size_t line_begin = begin;
+    for (size_t pos = begin; pos < end; ) {
+        String_View chunk = buffer_chunk(buffer, pos);
+        if (chunk.count > end - pos) chunk.count = end - pos;
+        if (chunk.count > SCAN_BLOCK_SIZE) chunk.count = SCAN_BLOCK_SIZE;
+        size_t n = scan_newlines(chunk.data, chunk.count, newlines);
+        for (size_t i = 0; i < n; ++i) {
+            size_t line_end = pos + newlines[i] + 1;
+            lines_build_push(lines, lines_alloc(lines, line_end - line_begin));
+            line_begin = line_end;
+        }
+        pos += chunk.count;
+    }
+    lines_build_push(lines, lines_alloc(lines, end - line_begin + (newline_at_end ? 1 : 0)));
+}
+
+Line lines_at(const Lines *lines, size_t row)
+{
+    assert(row < lines->count);
+
+    size_t begin = 0;
+    size_t k = row;
+    uint32_t t = lines->root;
+    for (;;) {
+        assert(t != 0);
+        const Line_Node *n = &NODE(t);
+        size_t left_size = NODE(n->left).size;
+        if (k < left_size) {
+            t = n->left;
+        } else if (k == left_size) {
+            begin += NODE(n->left).sum;
+            Line line = {
+                .begin = begin,
+                .end = begin + n->length,
+            };
+            if (row + 1 < lines->count) line.end -= 1; // only the last line has no newline
+            return line;
+        } else {
+            begin += NODE(n->left).sum + n->length;
+            k -= left_size + 1;
+            t = n->right;
+        }
+    }
+}
+
+size_t lines_row_of(const Lines *lines, size_t pos)
+{
+    assert(lines->count > 0);
+
+    size_t row = 0;
+    uint32_t t = lines->root;
+    while (t != 0) {
+        const Line_Node *n = &NODE(t);
+        size_t left_sum = NODE(n->left).sum;
+        if (pos < left_sum) {
+            t = n->left;
+        } else if (pos < left_sum + n->length) {
+            return row + NODE(n->left).size;
+        } else {
+            pos -= left_sum + n->length;
+            row += NODE(n->left).size + 1;
+            t = n->right;
+        }
+    }
+    return lines->count - 1;
+}
+
+void lines_rebuild(Lines *lines, const Buffer *buffer)
+{
+    scan_init();
+    lines_index_finish(lines);
+    lines->nodes.count = 0;
+    lines->free_list = 0;
+    lines->stack.count = 0;
+
+    lines_scan(lines, buffer, 0, buffer->count, false);
+    lines->root = lines_build_end(lines);
+    lines->count = NODE(lines->root).size;
+}
+
+static void lines_index_edited(Lines_Indexer *ix, size_t pos, size_t removed, size_t inserted);
+
+void lines_splice(Lines *lines, const Buffer *buffer, size_t pos, size_t removed, size_t inserted)
+{
+    assert(lines->count > 0);
+
+    size_t first = lines_row_of(lines, pos);
+    size_t last = lines_row_of(lines, pos + removed);
+    size_t begin = lines_at(lines, first).begin;
+    size_t end = lines_at(lines, last).end - removed + inserted;
+    bool newline_at_end = last + 1 < lines->count;
+
+    // While indexing the last row is the rest of the file that nobody has scanned yet. An edit of it
+    // only scans up to where the edit ends, what comes after that stays a part of the last row.
+    size_t rest = 0;
+    if (lines->indexer != NULL) {
+        lines_index_edited(lines->indexer, pos, removed, inserted);
+        if (last + 1 == lines->count) {
+            end = first + 1 < lines->count ? pos + inserted : begin;
+            rest = buffer->count - end;
+        }
+    }
+
+    uint32_t head, middle, tail;
+    lines_split(lines, lines->root, first, &head, &tail);
+    lines_split(lines, tail, last - first + 1, &middle, &tail);
+    lines_free(lines, middle);
+
+    lines->stack.count = 0;
+    lines_scan(lines, buffer, begin, end, newline_at_end);
+    // NOTE: the line pushed last is on top of the stack and gets its sum in lines_build_end()
+    NODE(da_last(&lines->stack)).length += rest;
+    middle = lines_build_end(lines);
+
+    lines->root = lines_merge(lines, head, lines_merge(lines, middle, tail));
+    lines->count = NODE(lines->root).size;
+}
+
+// Parallel indexing of big files. The text is cut into chunks that the workers grab one by one.
+// First every chunk counts its newlines, then a prefix sum over the counts tells every chunk
+// which node ids its lines get and where its first line begins, and then the chunks build their
+// subtrees straight into the new node array. The subtrees are merged in order at the end.
+
+#define LINES_INDEX_CHUNK_SIZE (16*1024*1024)
+#define LINES_INDEX_PREFIX_SIZE (1024*1024)
+#define LINES_INDEX_MAX_THREADS 64
+
+typedef struct {
+    size_t begin;
+    size_t size;
+    size_t count;      // newlines in the chunk
+    size_t last_end;   // just past the last newline of the chunk
+    size_t line_begin; // where the line ending at the first newline begins
+    uint32_t first_id;
+    uint32_t root;
+} Lines_Chunk;
+
+typedef enum {
+    LINES_INDEX_COUNT,
+    LINES_INDEX_BUILD,
+} Lines_Index_Phase;
+
+struct Lines_Indexer {
+    const char *data;
+    size_t size;
+    size_t prefix; // bytes that were indexed right away
+
+    // The workers index the mapped file and not the pieces. The edits made in the meantime are
+    // merged into one: [dirty_begin, dirty_old_end) of the file is now [dirty_begin, dirty_new_end)
+    // of the buffer, and those bytes are spliced into the finished index.
+    const Buffer *buffer;
+    bool dirty;
+    size_t dirty_begin;
+    size_t dirty_old_end;
+    size_t dirty_new_end;
+
+    Lines_Chunk *chunks;
+    size_t chunks_count;
+    Line_Nodes nodes;
+
+    Lines_Index_Phase phase;
+    SDL_atomic_t next;
+    SDL_atomic_t done;
+    SDL_Thread *threads[LINES_INDEX_MAX_THREADS];
+    size_t threads_count;
+};
+
+static void lines_chunk_count(const Lines_Indexer *ix, Lines_Chunk *chunk)
+{
+    uint32_t newlines[SCAN_BLOCK_SIZE];
+    for (size_t pos = chunk->begin; pos < chunk->begin + chunk->size; pos += SCAN_BLOCK_SIZE) {
+        size_t size = chunk->begin + chunk->size - pos;
+        if (size > SCAN_BLOCK_SIZE) size = SCAN_BLOCK_SIZE;
+        size_t n = scan_newlines(ix->data + pos, size, newlines);
+        if (n > 0) {
+            chunk->count += n;
+            chunk->last_end = pos + newlines[n - 1] + 1;
+        }
+    }
+}
+
+static void lines_chunk_build(const Lines_Indexer *ix, Lines_Chunk *chunk, size_t index)
+{
+    // A view of the shared node array. Every chunk writes only its own ids.
+    Lines view = {
+        .nodes = ix->nodes,
+        .seed = (uint32_t) (index + 1)*0x9E3779B9,
+    };
+
+    uint32_t newlines[SCAN_BLOCK_SIZE];
+    uint32_t id = chunk->first_id;
+    size_t line_begin = chunk->line_begin;
+    for (size_t pos = chunk->begin; pos < chunk->begin + chunk->size; pos += SCAN_BLOCK_SIZE) {
+        size_t size = chunk->begin + chunk->size - pos;
+        if (size > SCAN_BLOCK_SIZE) size = SCAN_BLOCK_SIZE;
+        size_t n = scan_newlines(ix->data + pos, size, newlines);
+        for (size_t i = 0; i < n; ++i) {
+            size_t line_end = pos + newlines[i] + 1;
+            lines_node_init(&view, id, line_end - line_begin);
+            lines_build_push(&view, id);
+            id += 1;
+            line_begin = line_end;
+        }
+    }
+    chunk->root = lines_build_end(&view);
+    free(view.stack.items);
+}
+
+static int SDLCALL lines_index_worker(void *data)
+{
+    Lines_Indexer *ix = data;
+    for (;;) {
+        size_t index = (size_t) SDL_AtomicAdd(&ix->next, 1);
+        if (index >= ix->chunks_count) break;
+        switch (ix->phase) {
+        case LINES_INDEX_COUNT: lines_chunk_count(ix, &ix->chunks[index]); break;
+        case LINES_INDEX_BUILD: lines_chunk_build(ix, &ix->chunks[index], index); break;
+        }
+        SDL_AtomicAdd(&ix->done, 1);
+    }
+    return 0;
+}
+
+static void lines_index_spawn(Lines_Indexer *ix, Lines_Index_Phase phase)
+{
+    ix->phase = phase;
+    SDL_AtomicSet(&ix->next, 0);
+    SDL_AtomicSet(&ix->done, 0);
+
+    size_t threads_count = SDL_GetCPUCount();
+    if (threads_count < 1) threads_count = 1;
+    if (threads_count > LINES_INDEX_MAX_THREADS) threads_count = LINES_INDEX_MAX_THREADS;
+    if (threads_count > ix->chunks_count) threads_count = ix->chunks_count;
+
+    ix->threads_count = 0;
+    for (size_t i = 0; i < threads_count; ++i) {
+        SDL_Thread *thread = SDL_CreateThread(lines_index_worker, "lines_index", ix);
+        if (thread == NULL) break;
+        ix->threads[ix->threads_count++] = thread;
+    }
+    // NOTE: no threads is not fatal, we just do the work ourselves
+    if (ix->threads_count == 0) lines_index_worker(ix);
+}
+
+static void lines_index_join(Lines_Indexer *ix)
+{
+    for (size_t i = 0; i < ix->threads_count; ++i) {
+        SDL_WaitThread(ix->threads[i], NULL);
+    }
+    ix->threads_count = 0;
+}
+
+// Moves on to the next phase once all the chunks of the current one are done
+static void lines_index_advance(Lines *lines)
+{
+    Lines_Indexer *ix = lines->indexer;
+    lines_index_join(ix);
+
+    switch (ix->phase) {
+    case LINES_INDEX_COUNT: {
+        size_t total = 0;
+        size_t line_begin = 0;
+        for (size_t i = 0; i < ix->chunks_count; ++i) {
+            Lines_Chunk *chunk = &ix->chunks[i];
+            chunk->first_id = (uint32_t) (total + 1);
+            chunk->line_begin = line_begin;
+            total += chunk->count;
+            if (chunk->count > 0) line_begin = chunk->last_end;
+        }
+        // the nil node, every line that ends with a newline and the last line
+        assert(total + 2 <= UINT32_MAX);
+        ix->nodes.capacity = total + 2;
+        ix->nodes.items = malloc(ix->nodes.capacity*sizeof(*ix->nodes.items));
+        assert(ix->nodes.items != NULL && "Buy more RAM lol");
+        ix->nodes.count = ix->nodes.capacity;
+        memset(&ix->nodes.items[0], 0, sizeof(ix->nodes.items[0]));
+
+        lines_index_spawn(ix, LINES_INDEX_BUILD);
+    } break;
+
+    case LINES_INDEX_BUILD: {
+        free(lines->nodes.items);
+        lines->nodes = ix->nodes;
+        lines->free_list = 0;
+        lines->stack.count = 0;
+
+        uint32_t root = 0;
+        size_t line_begin = 0;
+        for (size_t i = 0; i < ix->chunks_count; ++i) {
+            root = lines_merge(lines, root, ix->chunks[i].root);
+            if (ix->chunks[i].count > 0) line_begin = ix->chunks[i].last_end;
+        }
+        uint32_t last = (uint32_t) (lines->nodes.count - 1);
+        lines_node_init(lines, last, ix->size - line_begin);
+        lines->root = lines_merge(lines, root, last);
+        lines->count = NODE(lines->root).size;
+
+        lines->indexer = NULL;
+        if (ix->dirty) {
+            lines_splice(lines, ix->buffer, ix->dirty_begin, ix->dirty_old_end - ix->dirty_begin, ix->dirty_new_end - ix->dirty_begin);
+        }
+
+        free(ix->chunks);
+        free(ix);
+    } break;
+    }
+}
+
+void lines_index_start(Lines *lines, const Buffer *buffer)
+{
+    // NOTE: the kernel is picked here on the main thread before the workers exist
+    scan_init();
+    lines_index_finish(lines);
+
+    // NOTE: only the untouched mapped file is indexed in the background. The workers read it
+    // directly, so the buffer may be edited in the meantime as long as it stays mapped.
+    String_View text = buffer_chunk(buffer, 0);
+    if (text.count != buffer->count || text.count < 2*LINES_INDEX_CHUNK_SIZE) {
+        lines_rebuild(lines, buffer);
+        return;
+    }
+
+    Lines_Indexer *ix = malloc(sizeof(*ix));
+    assert(ix != NULL && "Buy more RAM lol");
+    memset(ix, 0, sizeof(*ix));
+    ix->data = text.data;
+    ix->size = text.count;
+    ix->buffer = buffer;
+
+    // The first screen is indexed right away. The rest is one long line for now.
+    ix->prefix = LINES_INDEX_PREFIX_SIZE;
+    while (ix->prefix > 0 && ix->data[ix->prefix - 1] != '\n') ix->prefix -= 1;
+
+    lines->nodes.count = 0;
+    lines->free_list = 0;
+    lines->stack.count = 0;
+    if (ix->prefix > 0) lines_scan(lines, buffer, 0, ix->prefix - 1, true);
+    lines_build_push(lines, lines_alloc(lines, ix->size - ix->prefix));
+    lines->root = lines_build_end(lines);
+    lines->count = NODE(lines->root).size;
+
+    ix->chunks_count = (ix->size + LINES_INDEX_CHUNK_SIZE - 1)/LINES_INDEX_CHUNK_SIZE;
+    ix->chunks = malloc(ix->chunks_count*sizeof(*ix->chunks));
+    assert(ix->chunks != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < ix->chunks_count; ++i) {
+        size_t begin = i*LINES_INDEX_CHUNK_SIZE;
+        size_t size = ix->size - begin;
+        if (size > LINES_INDEX_CHUNK_SIZE) size = LINES_INDEX_CHUNK_SIZE;
+        ix->chunks[i] = (Lines_Chunk) {
+            .begin = begin,
+            .size = size,
+        };
+    }
+
+    lines->indexer = ix;
+    lines_index_spawn(ix, LINES_INDEX_COUNT);
+}
+
+static void lines_index_edited(Lines_Indexer *ix, size_t pos, size_t removed, size_t inserted)
+{
+    if (!ix->dirty) {
+        ix->dirty = true;
+        ix->dirty_begin = pos;
+        ix->dirty_old_end = pos;
+        ix->dirty_new_end = pos;
+    }
+
+    size_t end = ix->dirty_new_end > pos + removed ? ix->dirty_new_end : pos + removed;
+    if (ix->dirty_begin > pos) ix->dirty_begin = pos;
+    ix->dirty_old_end += end - ix->dirty_new_end;
+    ix->dirty_new_end = end - removed + inserted;
+}
+
+bool lines_indexing(const Lines *lines)
+{
+    return lines->indexer != NULL;
+}
+
+void lines_index_poll(Lines *lines)
+{
+    while (lines->indexer != NULL && (size_t) SDL_AtomicGet(&lines->indexer->done) == lines->indexer->chunks_count) {
+        lines_index_advance(lines);
+    }
+}
+
+void lines_index_finish(Lines *lines)
+{
+    while (lines->indexer != NULL) {
+        lines_index_join(lines->indexer);
+        lines_index_advance(lines);
+    }
+}
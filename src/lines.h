@@ -0,0 +1,75 @@
+#ifndef LINES_H_
+#define LINES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "./buffer.h"
+
+typedef struct {
+    size_t begin;
+    size_t end;
+} Line;
+
+// A node of the line tree is a single line. The tree is ordered by rows,
+// and each node knows the amount of lines and bytes in its subtree, so
+// both row->offset and offset->row are answered by a single descent.
+typedef struct {
+    uint32_t left;
+    uint32_t right;
+    uint32_t priority;
+    uint32_t size;     // lines in the subtree
+    size_t length;     // bytes of the line including its newline
+    size_t sum;        // bytes in the subtree
+} Line_Node;
+
+typedef struct {
+    Line_Node *items;
+    size_t count;
+    size_t capacity;
+} Line_Nodes;
+
+typedef struct {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Line_Ids;
+
+// Background indexing state of a freshly loaded file, see lines_index_start()
+typedef struct Lines_Indexer Lines_Indexer;
+
+// Line index of a Buffer as a treap keyed by row. There is always at least one line.
+typedef struct {
+    Line_Nodes nodes; // nodes.items[0] is the nil node
+    uint32_t root;
+    uint32_t free_list;
+    uint32_t seed;
+    size_t count;
+
+    Line_Ids stack; // scratch space for building subtrees
+
+    Lines_Indexer *indexer; // not NULL while the buffer is being indexed in the background
+} Lines;
+
+// O(log n)
+Line lines_at(const Lines *lines, size_t row);
+// The row that contains pos, O(log n). The newline belongs to the line it ends.
+size_t lines_row_of(const Lines *lines, size_t pos);
+// Reindexes the whole buffer.
+void lines_rebuild(Lines *lines, const Buffer *buffer);
+// Indexes a buffer that was just loaded on all cores. Only the first screen is indexed right
+// away; the rest of the text stays a single last line until lines_index_poll() finishes the job.
+// Small or already edited buffers are indexed on the spot like lines_rebuild() does.
+// The buffer is kept until then, the edits that are spliced in the meantime are read from it.
+void lines_index_start(Lines *lines, const Buffer *buffer);
+bool lines_indexing(const Lines *lines);
+// Picks up the results of the workers without blocking. Call it every frame.
+void lines_index_poll(Lines *lines);
+// Blocks until the index is complete.
+void lines_index_finish(Lines *lines);
+// Updates the index after the buffer replaced `removed` bytes at pos with `inserted` bytes.
+// Only the rows touched by the edit are rescanned and replaced. While indexing, an edit of the
+// last line leaves it the rest of the file, and the edits are redone on the finished index.
+void lines_splice(Lines *lines, const Buffer *buffer, size_t pos, size_t removed, size_t inserted);
+
+#endif // LINES_H_
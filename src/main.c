@@ -94,6 +94,9 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    // NOTE: the editor lexes C until a file is loaded, and the highlighter thread only reads the languages
+    lexer_init();
+
     if (argc > 1) {
         const char *file_path = argv[1];
         const char *dir_path = ".";
@@ -192,6 +195,8 @@ int main(int argc, char **argv)
     while (!context.quit) {
         const Uint32 start = SDL_GetTicks();
         handle_events(&context, &editor, &sr);
+        editor_update(&editor);
+        project_search_update(&fb.search);
 
         Vec4f bg = hex_to_vec4f(0x181818FF);
         glClearColor(bg.x, bg.y, bg.z, bg.w);
@@ -360,8 +365,7 @@ static void handle_events_normal_mode(Editor *editor, SDL_Event event)
 
         case SDLK_x: {
             if (!editor->selection) {
-                editor->selection = true;
-                editor_update_selection(editor, event.key.keysym.mod & KMOD_SHIFT);
+                editor_update_selection(editor, true);
                 editor_move_char_right(editor);
                 editor->last_stroke = SDL_GetTicks();
             }
@@ -509,7 +513,9 @@ static void handle_events_insert_mode(Editor *editor, SDL_Event event)
         break;
 
         case SDLK_f: {
-            if (event.key.keysym.mod & KMOD_CTRL) {
+            if ((event.key.keysym.mod & KMOD_CTRL) && (event.key.keysym.mod & KMOD_SHIFT)) {
+                editor_search_prev(editor);
+            } else if (event.key.keysym.mod & KMOD_CTRL) {
                 editor_start_search(editor);
             }
         }
@@ -548,6 +554,25 @@ static void handle_events_insert_mode(Editor *editor, SDL_Event event)
         case SDLK_c: {
             if (event.key.keysym.mod & KMOD_CTRL) {
                 editor_clipboard_copy(editor);
+            } else if (editor->searching && (event.key.keysym.mod & KMOD_ALT)) {
+                editor_search_toggle_ignore_case(editor);
+                SDL_FlushEvent(SDL_TEXTINPUT);
+            }
+        }
+        break;
+
+        case SDLK_w: {
+            if (editor->searching && (event.key.keysym.mod & KMOD_ALT)) {
+                editor_search_toggle_whole_word(editor);
+                SDL_FlushEvent(SDL_TEXTINPUT);
+            }
+        }
+        break;
+
+        case SDLK_r: {
+            if (editor->searching && (event.key.keysym.mod & KMOD_ALT)) {
+                editor_search_toggle_regex(editor);
+                SDL_FlushEvent(SDL_TEXTINPUT);
             }
         }
         break;
@@ -630,11 +655,123 @@ static void handle_events_insert_mode(Editor *editor, SDL_Event event)
     }
 }
 
+// Typing what to look for in the files under the dir of the file browser and going through what was found
+static void handle_events_project_search(Editor *editor, SDL_Event event)
+{
+    switch (event.type) {
+    case SDL_KEYDOWN: {
+        switch (event.key.keysym.sym) {
+        case SDLK_ESCAPE: {
+            if (fb.typing && fb.showing_results) {
+                fb.typing = false;
+            } else {
+                fb_stop_search(&fb);
+            }
+        }
+        break;
+
+        case SDLK_BACKSPACE: {
+            if (fb.typing && fb.needle.count > 0) fb.needle.count -= 1;
+        }
+        break;
+
+        case SDLK_c: {
+            if (fb.typing && (event.key.keysym.mod & KMOD_ALT)) {
+                editor_search_toggle_ignore_case(editor);
+                SDL_FlushEvent(SDL_TEXTINPUT);
+            }
+        }
+        break;
+
+        case SDLK_w: {
+            if (fb.typing && (event.key.keysym.mod & KMOD_ALT)) {
+                editor_search_toggle_whole_word(editor);
+                SDL_FlushEvent(SDL_TEXTINPUT);
+            }
+        }
+        break;
+
+        case SDLK_r: {
+            if (fb.typing && (event.key.keysym.mod & KMOD_ALT)) {
+                editor_search_toggle_regex(editor);
+                SDL_FlushEvent(SDL_TEXTINPUT);
+            }
+        }
+        break;
+
+        case SDLK_f: {
+            if (event.key.keysym.mod & KMOD_CTRL) {
+                fb.typing = true;
+            }
+        }
+        break;
+
+        case SDLK_k:
+        case SDLK_UP: {
+            if (!fb.typing && fb.result_cursor > 0) fb.result_cursor -= 1;
+        }
+        break;
+
+        case SDLK_j:
+        case SDLK_DOWN: {
+            if (!fb.typing && fb.result_cursor + 1 < fb.search.results.count) fb.result_cursor += 1;
+        }
+        break;
+
+        case SDLK_RETURN: {
+            if (fb.typing) {
+                if (fb.needle.count > 0) {
+                    fb_start_search(&fb, editor->search_ignore_case, editor->search_whole_word, editor->search_regex);
+                }
+                break;
+            }
+
+            size_t pos;
+            const char *file_path = fb_result_path(&fb, &pos);
+            if (file_path) {
+                // TODO: before opening a new file make sure you don't have unsaved changes
+                Errno err = editor_load_from_file(editor, file_path);
+                if (err != 0) {
+                    flash_error("Could not open file %s: %s", file_path, strerror(err));
+                } else {
+                    // NOTE: the file may have changed since it was searched
+                    editor->cursor = pos < editor->data.count ? pos : editor->data.count;
+                    editor->mode = EDITOR_MODE_NORMAL;
+                }
+            }
+        }
+        break;
+        }
+    }
+    break;
+
+    case SDL_TEXTINPUT: {
+        if (fb.typing) {
+            sb_append_cstr(&fb.needle, event.text.text);
+        }
+    }
+    break;
+    }
+}
+
 static void handle_events_browse_mode(Editor *editor, SDL_Event event)
 {
+    if (fb.typing || fb.showing_results) {
+        handle_events_project_search(editor, event);
+        return;
+    }
+
     switch (event.type) {
     case SDL_KEYDOWN: {
         switch (event.key.keysym.sym) {
+        case SDLK_f: {
+            if (event.key.keysym.mod & KMOD_CTRL) {
+                fb.typing = true;
+                fb.needle.count = 0;
+            }
+        }
+        break;
+
         case SDLK_ESCAPE: {
             editor->mode = EDITOR_MODE_NORMAL;
         }
@@ -0,0 +1,344 @@
+#include <assert.h>
+#include <string.h>
+
+#ifdef _WIN32
+#    include <minirent.h>
+#else
+#    include <dirent.h>
+#endif // _WIN32
+
+#include "./buffer.h"
+#include "./project_search.h"
+#include "./regex.h"
+#include "./search.h"
+
+// What a worker keeps from file to file
+typedef struct {
+    Searcher searcher;
+    Regex re;
+    Buffer view;                  // a single piece over the mapped file
+    String_Builder path;
+    Project_Search_Results found; // in the current file
+    String_Builder found_strings;
+} Project_Search_Worker;
+
+static void project_search_push_dir(Project_Search *ps, const char *path, size_t count)
+{
+    char *dir = malloc(count + 1);
+    assert(dir != NULL && "Buy more RAM lol");
+    memcpy(dir, path, count);
+    dir[count] = '\0';
+
+    SDL_LockMutex(ps->lock);
+    da_append(&ps->dirs, dir);
+    SDL_CondSignal(ps->wake);
+    SDL_UnlockMutex(ps->lock);
+}
+
+// Hands what the worker found in a file over to the search
+static void project_search_file_done(Project_Search *ps, Project_Search_Worker *w)
+{
+    SDL_LockMutex(ps->lock);
+    size_t base = ps->found_strings.count;
+    size_t count = w->found.count;
+    if (count > PROJECT_SEARCH_RESULTS_CAP - ps->found_total) count = PROJECT_SEARCH_RESULTS_CAP - ps->found_total;
+    for (size_t i = 0; i < count; ++i) {
+        Project_Search_Result r = w->found.items[i];
+        r.path += base;
+        r.line += base;
+        da_append(&ps->found, r);
+    }
+    sb_append_buf(&ps->found_strings, w->found_strings.items, w->found_strings.count);
+    ps->found_total += count;
+    ps->files_searched += 1;
+    if (ps->found_total >= PROJECT_SEARCH_RESULTS_CAP) {
+        SDL_AtomicSet(&ps->stop, 1);
+        SDL_CondBroadcast(ps->wake);
+    }
+    SDL_UnlockMutex(ps->lock);
+
+    w->found.count = 0;
+    w->found_strings.count = 0;
+}
+
+static bool project_search_find(const Project_Search *ps, Project_Search_Worker *w, size_t from, size_t *pos)
+{
+    if (ps->regex) {
+        size_t end;
+        return regex_next(&w->re, &w->view, from, pos, &end);
+    }
+    return search_next(&w->searcher, &w->view, from, pos);
+}
+
+// Where the window of the file that the search goes on in from begin ends
+static size_t project_search_window_end(const Project_Search *ps, const char *data, size_t size, size_t begin)
+{
+    size_t end = begin + PROJECT_SEARCH_WINDOW_SIZE + ps->needle.count;
+    if (end >= size) return size;
+    if (ps->regex) {
+        // NOTE: regex matches never span lines, so a window that ends where a line does has all of them.
+        // A single line longer than the window is searched whole though.
+        const char *newline = memchr(data + end, '\n', size - end);
+        return newline != NULL ? (size_t) (newline - data) : size;
+    }
+    return end;
+}
+
+static void project_search_file(Project_Search *ps, Project_Search_Worker *w, const char *path)
+{
+    const char *data;
+    size_t size;
+    if (map_entire_file(path, &data, &size) != 0) return;
+
+    // NOTE: a zero byte near the beginning means a binary file, its "lines" are not worth showing
+    size_t head = size < 4096 ? size : 4096;
+    if (size > 0 && memchr(data, '\0', head) == NULL) {
+        w->view.original = data;
+        w->view.original_size = size;
+        w->view.pieces.count = 0;
+        da_append(&w->view.pieces, ((Piece) {.data = data, .count = size, .begin = 0}));
+
+        size_t path_offset = SIZE_MAX;
+        size_t row = 0;
+        size_t line_begin = 0; // of the row
+        size_t from = 0;       // where the search goes on
+        while (from <= size && w->found.count < PROJECT_SEARCH_RESULTS_CAP && !SDL_AtomicGet(&ps->stop)) {
+            // NOTE: the view only goes up to the end of the window, so a big file with few matches
+            // is not searched to the end before the worker looks at stop again
+            size_t window_end = project_search_window_end(ps, data, size, from);
+            w->view.count = window_end;
+            w->view.pieces.items[0].count = window_end;
+            regex_forget(&w->re);
+
+            size_t pos;
+            if (!project_search_find(ps, w, from, &pos)) {
+                if (window_end == size) break;
+                // A literal match may begin in the last bytes of the window and go on past it
+                from = ps->regex ? window_end + 1 : window_end + 1 - ps->needle.count;
+                continue;
+            }
+            if (!ps->regex && window_end < size && pos + ps->needle.count >= window_end) {
+                // It may go on past the window, or be followed by more of the word. The next window has all of it.
+                from = pos;
+                continue;
+            }
+
+            for (const char *newline; (newline = memchr(data + line_begin, '\n', pos - line_begin)) != NULL;) {
+                line_begin = (size_t) (newline - data) + 1;
+                row += 1;
+            }
+            const char *newline = memchr(data + pos, '\n', size - pos);
+            size_t line_end = newline != NULL ? (size_t) (newline - data) : size;
+
+            if (path_offset == SIZE_MAX) {
+                path_offset = w->found_strings.count;
+                sb_append_cstr(&w->found_strings, path);
+                sb_append_null(&w->found_strings);
+            }
+            size_t text = line_begin;
+            while (text < line_end && (data[text] == ' ' || data[text] == '\t')) text += 1;
+            size_t text_count = line_end - text;
+            if (text_count > PROJECT_SEARCH_LINE_CAP) text_count = PROJECT_SEARCH_LINE_CAP;
+            da_append(&w->found, ((Project_Search_Result) {
+                .path = path_offset,
+                .line = w->found_strings.count,
+                .line_count = text_count,
+                .row = row,
+                .pos = pos,
+            }));
+            sb_append_buf(&w->found_strings, data + text, text_count);
+
+            // NOTE: a line is listed once, the editor steps through the rest of its matches
+            line_begin = line_end + 1;
+            row += 1;
+            from = line_begin;
+        }
+    }
+    unmap_entire_file(data, size);
+    project_search_file_done(ps, w);
+}
+
+static void project_search_dir(Project_Search *ps, Project_Search_Worker *w, const char *dir_path)
+{
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL) return;
+
+    struct dirent *ent;
+    while (!SDL_AtomicGet(&ps->stop) && (ent = readdir(dir)) != NULL) {
+        // NOTE: hidden entries are skipped, which takes care of . and .. and the likes of .git too
+        if (ent->d_name[0] == '.') continue;
+
+        w->path.count = 0;
+        sb_append_cstr(&w->path, dir_path);
+        sb_append_cstr(&w->path, "/");
+        sb_append_cstr(&w->path, ent->d_name);
+        sb_append_null(&w->path);
+
+        File_Type type = FT_OTHER;
+#ifdef _WIN32
+        // NOTE: the entries of minirent only have a name, so the type is looked up like the file browser does
+        if (type_of_file(w->path.items, &type) != 0) type = FT_OTHER;
+#else
+        switch (ent->d_type) {
+        case DT_REG:
+            type = FT_REGULAR;
+            break;
+        case DT_DIR:
+            type = FT_DIRECTORY;
+            break;
+        case DT_UNKNOWN:
+            if (type_of_file(w->path.items, &type) != 0) type = FT_OTHER;
+            break;
+        }
+#endif // _WIN32
+
+        if (type == FT_DIRECTORY) {
+            project_search_push_dir(ps, w->path.items, w->path.count - 1);
+        } else if (type == FT_REGULAR) {
+            project_search_file(ps, w, w->path.items);
+        }
+    }
+    closedir(dir);
+}
+
+static int SDLCALL project_search_worker(void *data)
+{
+    Project_Search *ps = data;
+    Project_Search_Worker w = {0};
+    // NOTE: the DFAs of a regex are built as it runs, so every worker needs its own
+    if (ps->regex) regex_compile(&w.re, ps->needle.items, ps->needle.count, ps->ignore_case);
+    searcher_init(&w.searcher, ps->needle.items, ps->needle.count, ps->ignore_case, ps->whole_word);
+
+    SDL_LockMutex(ps->lock);
+    for (;;) {
+        // Nothing queued is only the end once no dir is being walked, those could queue more
+        while (ps->dirs.count == 0 && ps->walking > 0 && !SDL_AtomicGet(&ps->stop)) {
+            SDL_CondWait(ps->wake, ps->lock);
+        }
+        if (ps->dirs.count == 0 || SDL_AtomicGet(&ps->stop)) break;
+
+        char *dir = ps->dirs.items[--ps->dirs.count];
+        ps->walking += 1;
+        SDL_UnlockMutex(ps->lock);
+
+        project_search_dir(ps, &w, dir);
+        free(dir);
+
+        SDL_LockMutex(ps->lock);
+        ps->walking -= 1;
+    }
+    // NOTE: wakes up the others to see that it's over
+    SDL_CondBroadcast(ps->wake);
+    SDL_UnlockMutex(ps->lock);
+
+    regex_free(&w.re);
+    free(w.view.pieces.items);
+    free(w.path.items);
+    free(w.found.items);
+    free(w.found_strings.items);
+    SDL_AtomicAdd(&ps->exited, 1);
+    return 0;
+}
+
+static void project_search_join(Project_Search *ps)
+{
+    for (size_t i = 0; i < ps->threads_count; ++i) {
+        SDL_WaitThread(ps->threads[i], NULL);
+    }
+    ps->threads_count = 0;
+    for (size_t i = 0; i < ps->dirs.count; ++i) {
+        free(ps->dirs.items[i]);
+    }
+    ps->dirs.count = 0;
+    ps->walking = 0;
+    ps->running = false;
+}
+
+void project_search_start(Project_Search *ps, const char *dir_path, const char *needle, size_t needle_len,
+                          bool ignore_case, bool whole_word, bool regex)
+{
+    project_search_stop(ps);
+
+    ps->results.count = 0;
+    ps->strings.count = 0;
+    ps->files = 0;
+    ps->found.count = 0;
+    ps->found_strings.count = 0;
+    ps->found_total = 0;
+    ps->files_searched = 0;
+    ps->error = NULL;
+
+    ps->root.count = 0;
+    sb_append_cstr(&ps->root, dir_path);
+    sb_append_null(&ps->root);
+    ps->needle.count = 0;
+    sb_append_buf(&ps->needle, needle, needle_len);
+    ps->ignore_case = ignore_case;
+    ps->whole_word = whole_word;
+    ps->regex = regex;
+
+    if (regex) {
+        Regex re;
+        if (!regex_compile(&re, needle, needle_len, ignore_case)) ps->error = re.error;
+        regex_free(&re);
+        if (ps->error != NULL) return;
+    }
+
+    if (ps->lock == NULL) ps->lock = SDL_CreateMutex();
+    if (ps->wake == NULL) ps->wake = SDL_CreateCond();
+    if (ps->lock == NULL || ps->wake == NULL) {
+        ps->error = "could not create the lock of the search";
+        return;
+    }
+
+    SDL_AtomicSet(&ps->stop, 0);
+    SDL_AtomicSet(&ps->exited, 0);
+    project_search_push_dir(ps, dir_path, strlen(dir_path));
+    ps->running = true;
+
+    size_t threads_count = SDL_GetCPUCount();
+    if (threads_count < 1) threads_count = 1;
+    if (threads_count > PROJECT_SEARCH_MAX_THREADS) threads_count = PROJECT_SEARCH_MAX_THREADS;
+    for (size_t i = 0; i < threads_count; ++i) {
+        SDL_Thread *thread = SDL_CreateThread(project_search_worker, "project_search", ps);
+        if (thread == NULL) break;
+        ps->threads[ps->threads_count++] = thread;
+    }
+    // NOTE: no threads is not fatal, we just do the work ourselves
+    if (ps->threads_count == 0) project_search_worker(ps);
+}
+
+void project_search_update(Project_Search *ps)
+{
+    if (ps->lock == NULL) return;
+    // NOTE: looked at before taking the results, a worker has handed everything over once it has exited
+    bool done = ps->running && (size_t) SDL_AtomicGet(&ps->exited) >= ps->threads_count;
+
+    // NOTE: the workers only hold the lock to hand over a file or take a dir, so this doesn't wait for long
+    SDL_LockMutex(ps->lock);
+    size_t base = ps->strings.count;
+    for (size_t i = 0; i < ps->found.count; ++i) {
+        Project_Search_Result r = ps->found.items[i];
+        r.path += base;
+        r.line += base;
+        da_append(&ps->results, r);
+    }
+    sb_append_buf(&ps->strings, ps->found_strings.items, ps->found_strings.count);
+    ps->found.count = 0;
+    ps->found_strings.count = 0;
+    ps->files = ps->files_searched;
+    SDL_UnlockMutex(ps->lock);
+
+    if (done) project_search_join(ps);
+}
+
+void project_search_stop(Project_Search *ps)
+{
+    if (!ps->running) return;
+    SDL_AtomicSet(&ps->stop, 1);
+    SDL_LockMutex(ps->lock);
+    SDL_CondBroadcast(ps->wake);
+    SDL_UnlockMutex(ps->lock);
+    project_search_join(ps);
+    project_search_update(ps);
+}
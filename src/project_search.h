@@ -0,0 +1,82 @@
+#ifndef PROJECT_SEARCH_H_
+#define PROJECT_SEARCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "./common.h"
+
+#include <SDL2/SDL.h>
+
+#define PROJECT_SEARCH_MAX_THREADS 64
+// The search stops once it has found this many lines
+#define PROJECT_SEARCH_RESULTS_CAP (100*1000)
+// How much of a line is kept to show it
+#define PROJECT_SEARCH_LINE_CAP 200
+// How much of a file is searched before a worker looks whether the search was stopped
+#define PROJECT_SEARCH_WINDOW_SIZE (64*1024)
+
+// A line with a match. The strings are offsets into the strings of the search because those grow.
+typedef struct {
+    size_t path;       // the path of the file, NUL-terminated
+    size_t line;       // the text of the line, without the leading whitespace
+    size_t line_count;
+    size_t row;        // of the line in the file
+    size_t pos;        // of the first match on the line in the file
+} Project_Search_Result;
+
+typedef struct {
+    Project_Search_Result *items;
+    size_t count;
+    size_t capacity;
+} Project_Search_Results;
+
+typedef struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} Project_Search_Dirs;
+
+// Looks for the text in every file under a directory. The directories are walked by a thread
+// per core, each file is mapped and searched like the editor searches its buffer, and the
+// lines with matches come in while the search goes on.
+typedef struct {
+    // What is looked for, read by all the workers
+    String_Builder root;
+    String_Builder needle;
+    bool ignore_case;
+    bool whole_word;
+    bool regex;
+    const char *error;          // why the regex did not compile
+
+    SDL_Thread *threads[PROJECT_SEARCH_MAX_THREADS];
+    size_t threads_count;
+    SDL_atomic_t exited;        // how many of the threads are done
+    SDL_atomic_t stop;
+
+    SDL_mutex *lock;
+    SDL_cond *wake;             // there are dirs to walk or nothing is left to do
+    // Protected by lock
+    Project_Search_Dirs dirs;   // the dirs waiting to be walked
+    size_t walking;             // the dirs being walked right now, which may queue more of them
+    Project_Search_Results found; // not taken by project_search_update() yet
+    String_Builder found_strings;
+    size_t found_total;
+    size_t files_searched;
+
+    // The results so far, only touched by the thread that started the search
+    Project_Search_Results results;
+    String_Builder strings;
+    size_t files;
+    bool running;
+} Project_Search;
+
+// Stops the search that is running, forgets its results and starts a new one in the background.
+// The search is like the one of the editor: the needle is a regex.h pattern if regex is set.
+void project_search_start(Project_Search *ps, const char *dir_path, const char *needle, size_t needle_len,
+                          bool ignore_case, bool whole_word, bool regex);
+// Takes what was found since the last call into ps->results. Never blocks for long.
+void project_search_update(Project_Search *ps);
+// Makes the workers stop and waits for them. The results found so far are kept.
+void project_search_stop(Project_Search *ps);
+
+#endif // PROJECT_SEARCH_H_
@@ -0,0 +1,1071 @@
+#include <assert.h>
+#include <string.h>
+#include "./common.h"
+#include "./regex.h"
+
+#define REGEX_NONE UINT32_MAX
+#define REGEX_INFINITY UINT32_MAX
+// How deep groups and repetitions may nest, the compiler recurses into them
+#define REGEX_DEPTH_CAP 256
+// The most a {n,m} may repeat
+#define REGEX_REPEAT_CAP 1000
+
+typedef struct {
+    uint64_t bits[4];
+} Regex_Set;
+
+typedef struct {
+    Regex_Set *items;
+    size_t count;
+    size_t capacity;
+} Regex_Sets;
+
+static inline bool regex_set_has(const Regex_Set *set, uint8_t x)
+{
+    return (set->bits[x >> 6] >> (x & 63)) & 1;
+}
+
+static inline void regex_set_add(Regex_Set *set, uint8_t x)
+{
+    set->bits[x >> 6] |= (uint64_t) 1 << (x & 63);
+}
+
+static void regex_set_add_range(Regex_Set *set, uint8_t lo, uint8_t hi)
+{
+    for (size_t x = lo; x <= hi; ++x) regex_set_add(set, (uint8_t) x);
+}
+
+typedef enum {
+    REGEX_EMPTY,
+    REGEX_BYTES,  // one byte out of set
+    REGEX_CONCAT, // lhs then rhs
+    REGEX_ALT,    // lhs or rhs
+    REGEX_REPEAT, // lhs min to max times
+} Regex_Node_Kind;
+
+typedef struct {
+    Regex_Node_Kind kind;
+    uint32_t lhs;
+    uint32_t rhs;
+    uint32_t set;
+    uint32_t min;
+    uint32_t max;
+} Regex_Node;
+
+typedef struct {
+    Regex_Node *items;
+    size_t count;
+    size_t capacity;
+} Regex_Nodes;
+
+typedef enum {
+    REGEX_NFA_SET,   // consumes a byte out of set and goes to out
+    REGEX_NFA_SPLIT, // goes to both out and out1 without consuming anything
+    REGEX_NFA_MATCH,
+} Regex_Nfa_Kind;
+
+typedef struct {
+    Regex_Nfa_Kind kind;
+    uint32_t set;
+    uint32_t out;
+    uint32_t out1;
+} Regex_Nfa_State;
+
+typedef struct {
+    Regex_Nfa_State *items;
+    size_t count;
+    size_t capacity;
+    uint32_t start;
+} Regex_Nfa;
+
+typedef struct {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Regex_Ids;
+
+#define REGEX_DFA_ACCEPTING 1
+#define REGEX_DFA_EMPTY 2
+
+typedef enum {
+    REGEX_RESTART_NEVER,         // only the start state begins a match
+    REGEX_RESTART_ALWAYS,        // a match may begin at every byte
+    REGEX_RESTART_AFTER_NEWLINE, // a match may begin at the beginning of every line
+} Regex_Restart;
+
+// The DFA of an NFA. A state is the set of NFA states the NFA could be in, its transitions
+// are worked out the first time they are taken.
+typedef struct {
+    const Regex_Nfa *nfa;
+    const Regex_Sets *sets;
+    Regex_Restart restart;
+
+    int32_t *next;            // 256 transitions per state, -1 if not worked out yet
+    uint8_t *flags;           // REGEX_DFA_ACCEPTING and REGEX_DFA_EMPTY
+    size_t *members_begin;    // the NFA states of state i are members[members_begin[i]..members_begin[i + 1])
+    size_t capacity;
+    size_t count;
+    Regex_Ids members;
+    int32_t table[2*REGEX_DFA_CAP]; // open addressing hash of the states by their members
+
+    Regex_Ids start_members;
+    int32_t start;
+    int32_t empty;            // no NFA states, a match may only begin at a restart
+
+    // Scratch space for working out a transition
+    Regex_Ids stack;
+    Regex_Ids scratch;
+    uint32_t *marks;
+    uint32_t mark;
+} Regex_Dfa;
+
+struct Regex_Program {
+    Regex_Sets sets;
+    Regex_Nfa forward_nfa;
+    Regex_Nfa reverse_nfa;
+    Regex_Dfa forward;  // finds where the first match ends
+    Regex_Dfa reverse;  // goes back over its line to where the leftmost match begins
+    Regex_Dfa anchored; // goes forward from there to where it ends
+};
+
+// Parsing
+
+typedef struct {
+    const char *pattern;
+    size_t count;
+    size_t pos;
+    size_t depth;
+    bool ignore_case;
+    Regex_Nodes nodes;
+    Regex_Sets *sets;
+    const char *error;
+} Regex_Parser;
+
+static uint32_t regex_parse_alt(Regex_Parser *p);
+
+static uint32_t regex_node(Regex_Parser *p, Regex_Node node)
+{
+    if (p->nodes.count >= REGEX_NFA_CAP && p->error == NULL) p->error = "pattern is too big";
+    da_append(&p->nodes, node);
+    return (uint32_t) p->nodes.count - 1;
+}
+
+// Adds the other case of the letters in set
+static void regex_set_fold(Regex_Set *set)
+{
+    for (uint8_t x = 'a'; x <= 'z'; ++x) {
+        if (regex_set_has(set, x) || regex_set_has(set, x & ~0x20)) {
+            regex_set_add(set, x);
+            regex_set_add(set, x & ~0x20);
+        }
+    }
+}
+
+static uint32_t regex_bytes(Regex_Parser *p, Regex_Set set)
+{
+    // NOTE: nothing matches a newline, so matches stay within lines
+    set.bits['\n' >> 6] &= ~((uint64_t) 1 << ('\n' & 63));
+    if (p->ignore_case) regex_set_fold(&set);
+    da_append(p->sets, set);
+    return regex_node(p, (Regex_Node) {.kind = REGEX_BYTES, .set = (uint32_t) p->sets->count - 1});
+}
+
+// Fills set for \d \w \s and their negations
+static bool regex_class_escape(char x, Regex_Set *set)
+{
+    Regex_Set class = {0};
+    switch (x | 0x20) {
+    case 'd':
+        regex_set_add_range(&class, '0', '9');
+        break;
+    case 'w':
+        regex_set_add_range(&class, '0', '9');
+        regex_set_add_range(&class, 'a', 'z');
+        regex_set_add_range(&class, 'A', 'Z');
+        regex_set_add(&class, '_');
+        break;
+    case 's':
+        regex_set_add(&class, ' ');
+        regex_set_add_range(&class, '\t', '\r');
+        break;
+    default:
+        return false;
+    }
+    bool negated = x >= 'A' && x <= 'Z';
+    for (size_t i = 0; i < 4; ++i) set->bits[i] |= negated ? ~class.bits[i] : class.bits[i];
+    return true;
+}
+
+static char regex_escape(char x)
+{
+    switch (x) {
+    case 't': return '\t';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case '0': return '\0';
+    default:  return x;
+    }
+}
+
+static uint32_t regex_parse_class(Regex_Parser *p)
+{
+    Regex_Set set = {0};
+    bool negated = p->pos < p->count && p->pattern[p->pos] == '^';
+    if (negated) p->pos += 1;
+    bool first = true;
+    while (p->pos < p->count && (first || p->pattern[p->pos] != ']')) {
+        first = false;
+        char lo = p->pattern[p->pos++];
+        if (lo == '\\' && p->pos < p->count) {
+            char x = p->pattern[p->pos++];
+            if (regex_class_escape(x, &set)) continue;
+            lo = regex_escape(x);
+        }
+        if (p->pos + 1 < p->count && p->pattern[p->pos] == '-' && p->pattern[p->pos + 1] != ']') {
+            p->pos += 1;
+            char hi = p->pattern[p->pos++];
+            if (hi == '\\' && p->pos < p->count) hi = regex_escape(p->pattern[p->pos++]);
+            if ((uint8_t) lo > (uint8_t) hi) {
+                p->error = "range out of order in [...]";
+                return 0;
+            }
+            regex_set_add_range(&set, (uint8_t) lo, (uint8_t) hi);
+        } else {
+            regex_set_add(&set, (uint8_t) lo);
+        }
+    }
+    if (p->pos >= p->count) {
+        p->error = "missing ]";
+        return 0;
+    }
+    p->pos += 1;
+    if (negated) {
+        // NOTE: [^b] ignoring case leaves out B too
+        if (p->ignore_case) regex_set_fold(&set);
+        for (size_t i = 0; i < 4; ++i) set.bits[i] = ~set.bits[i];
+    }
+    return regex_bytes(p, set);
+}
+
+static uint32_t regex_parse_atom(Regex_Parser *p)
+{
+    char x = p->pattern[p->pos++];
+    Regex_Set set = {0};
+    switch (x) {
+    case '(': {
+        if (p->pos + 1 < p->count && p->pattern[p->pos] == '?' && p->pattern[p->pos + 1] == ':') p->pos += 2;
+        if (++p->depth > REGEX_DEPTH_CAP) {
+            p->error = "groups are nested too deep";
+            return 0;
+        }
+        uint32_t node = regex_parse_alt(p);
+        p->depth -= 1;
+        if (p->error != NULL) return 0;
+        if (p->pos >= p->count) {
+            p->error = "missing )";
+            return 0;
+        }
+        p->pos += 1;
+        return node;
+    }
+    case '*':
+    case '+':
+    case '?':
+        p->error = "nothing to repeat";
+        return 0;
+    case '^':
+        p->error = "^ may only begin the pattern";
+        return 0;
+    case '$':
+        p->error = "$ may only end the pattern";
+        return 0;
+    case '.':
+        for (size_t i = 0; i < 4; ++i) set.bits[i] = ~(uint64_t) 0;
+        return regex_bytes(p, set);
+    case '[':
+        return regex_parse_class(p);
+    case '\\':
+        if (p->pos >= p->count) {
+            p->error = "\\ at the end of the pattern";
+            return 0;
+        }
+        x = p->pattern[p->pos++];
+        if (regex_class_escape(x, &set)) return regex_bytes(p, set);
+        regex_set_add(&set, (uint8_t) regex_escape(x));
+        return regex_bytes(p, set);
+    default:
+        regex_set_add(&set, (uint8_t) x);
+        return regex_bytes(p, set);
+    }
+}
+
+static bool regex_parse_number(Regex_Parser *p, uint32_t *n)
+{
+    size_t begin = p->pos;
+    *n = 0;
+    while (p->pos < p->count && p->pattern[p->pos] >= '0' && p->pattern[p->pos] <= '9') {
+        if (*n <= REGEX_REPEAT_CAP) *n = *n*10 + (uint32_t) (p->pattern[p->pos] - '0');
+        p->pos += 1;
+    }
+    return p->pos > begin;
+}
+
+// Parses {n}, {n,} or {n,m}. Anything else leaves the { to be a literal.
+static bool regex_parse_bounds(Regex_Parser *p, uint32_t *min, uint32_t *max)
+{
+    size_t begin = p->pos;
+    p->pos += 1;
+    if (regex_parse_number(p, min)) {
+        *max = *min;
+        if (p->pos < p->count && p->pattern[p->pos] == ',') {
+            p->pos += 1;
+            if (!regex_parse_number(p, max)) *max = REGEX_INFINITY;
+        }
+        if (p->pos < p->count && p->pattern[p->pos] == '}') {
+            p->pos += 1;
+            return true;
+        }
+    }
+    p->pos = begin;
+    return false;
+}
+
+static uint32_t regex_parse_repeat(Regex_Parser *p)
+{
+    uint32_t node = regex_parse_atom(p);
+    size_t repeats = 0;
+    while (p->error == NULL && p->pos < p->count) {
+        uint32_t min, max;
+        char x = p->pattern[p->pos];
+        if (x == '*') {
+            min = 0;
+            max = REGEX_INFINITY;
+            p->pos += 1;
+        } else if (x == '+') {
+            min = 1;
+            max = REGEX_INFINITY;
+            p->pos += 1;
+        } else if (x == '?') {
+            min = 0;
+            max = 1;
+            p->pos += 1;
+        } else if (x == '{' && regex_parse_bounds(p, &min, &max)) {
+            if (min > REGEX_REPEAT_CAP || (max != REGEX_INFINITY && max > REGEX_REPEAT_CAP)) {
+                p->error = "repetition is too big";
+                return 0;
+            }
+            if (min > max) {
+                p->error = "repetition out of order in {...}";
+                return 0;
+            }
+        } else {
+            break;
+        }
+        // NOTE: a lazy repetition matches the same text, only which match wins would differ
+        if (p->pos < p->count && p->pattern[p->pos] == '?') p->pos += 1;
+        if (++repeats > REGEX_DEPTH_CAP) {
+            p->error = "too many repetitions in a row";
+            return 0;
+        }
+        node = regex_node(p, (Regex_Node) {.kind = REGEX_REPEAT, .lhs = node, .min = min, .max = max});
+    }
+    return node;
+}
+
+static uint32_t regex_parse_concat(Regex_Parser *p)
+{
+    uint32_t node = REGEX_NONE;
+    while (p->error == NULL && p->pos < p->count && p->pattern[p->pos] != '|' && p->pattern[p->pos] != ')') {
+        uint32_t item = regex_parse_repeat(p);
+        node = node == REGEX_NONE ? item : regex_node(p, (Regex_Node) {.kind = REGEX_CONCAT, .lhs = node, .rhs = item});
+    }
+    return node == REGEX_NONE ? regex_node(p, (Regex_Node) {.kind = REGEX_EMPTY}) : node;
+}
+
+static uint32_t regex_parse_alt(Regex_Parser *p)
+{
+    uint32_t node = regex_parse_concat(p);
+    while (p->error == NULL && p->pos < p->count && p->pattern[p->pos] == '|') {
+        p->pos += 1;
+        uint32_t rhs = regex_parse_concat(p);
+        node = regex_node(p, (Regex_Node) {.kind = REGEX_ALT, .lhs = node, .rhs = rhs});
+    }
+    return node;
+}
+
+// Long concatenations and alternations lean left. Instead of recursing down their left side this
+// puts the nodes along it into spine[base..] from right to left and returns base.
+static size_t regex_spine(const Regex_Nodes *nodes, uint32_t node, Regex_Ids *spine)
+{
+    size_t base = spine->count;
+    Regex_Node_Kind kind = nodes->items[node].kind;
+    while (nodes->items[node].kind == kind) {
+        da_append(spine, nodes->items[node].rhs);
+        node = nodes->items[node].lhs;
+    }
+    da_append(spine, node);
+    return base;
+}
+
+static void regex_literal_break(String_Builder *run, String_Builder *best)
+{
+    if (run->count > best->count) {
+        best->count = 0;
+        sb_append_buf(best, run->items, run->count);
+    }
+    run->count = 0;
+}
+
+// The longest run of single bytes every match goes through is collected into best
+static void regex_literal(const Regex_Parser *p, uint32_t node, Regex_Ids *spine, String_Builder *run, String_Builder *best)
+{
+    Regex_Node n = p->nodes.items[node];
+    switch (n.kind) {
+    case REGEX_EMPTY:
+        break;
+    case REGEX_BYTES: {
+        const Regex_Set *set = &p->sets->items[n.set];
+        size_t count = 0;
+        uint8_t byte = 0;
+        for (size_t x = 0; x < 256; ++x) {
+            if (regex_set_has(set, (uint8_t) x)) {
+                count += 1;
+                byte = (uint8_t) x;
+            }
+        }
+        // NOTE: with ignore_case a letter comes in both cases and the search for the literal ignores case too
+        bool letter = (byte | 0x20) >= 'a' && (byte | 0x20) <= 'z';
+        if (count == 1 || (count == 2 && p->ignore_case && letter)) {
+            da_append(run, (char) byte);
+            return;
+        }
+    } break;
+    case REGEX_CONCAT: {
+        size_t base = regex_spine(&p->nodes, node, spine);
+        for (size_t i = spine->count; i-- > base;) {
+            regex_literal(p, spine->items[i], spine, run, best);
+        }
+        spine->count = base;
+        return;
+    }
+    case REGEX_REPEAT:
+        if (n.min > 0) {
+            regex_literal_break(run, best);
+            regex_literal(p, n.lhs, spine, run, best);
+        }
+        break;
+    case REGEX_ALT:
+        break;
+    }
+    regex_literal_break(run, best);
+}
+
+// Building the NFAs
+
+// A piece of the NFA with its loose ends. The loose ends are linked into a list through the
+// outs they are stored in: (state << 1 | 1) for out1, (state << 1) for out.
+typedef struct {
+    uint32_t start;
+    uint32_t ends;
+} Regex_Frag;
+
+typedef struct {
+    const Regex_Nodes *nodes;
+    Regex_Nfa *nfa;
+    bool reverse;
+    Regex_Ids spine;
+    const char *error;
+} Regex_Emitter;
+
+static uint32_t *regex_out(Regex_Nfa *nfa, uint32_t end)
+{
+    Regex_Nfa_State *state = &nfa->items[end >> 1];
+    return end & 1 ? &state->out1 : &state->out;
+}
+
+static void regex_patch(Regex_Nfa *nfa, uint32_t ends, uint32_t target)
+{
+    while (ends != REGEX_NONE) {
+        uint32_t *out = regex_out(nfa, ends);
+        ends = *out;
+        *out = target;
+    }
+}
+
+static uint32_t regex_join(Regex_Nfa *nfa, uint32_t a, uint32_t b)
+{
+    if (a == REGEX_NONE) return b;
+    uint32_t it = a;
+    while (*regex_out(nfa, it) != REGEX_NONE) it = *regex_out(nfa, it);
+    *regex_out(nfa, it) = b;
+    return a;
+}
+
+static uint32_t regex_state(Regex_Emitter *em, Regex_Nfa_Kind kind, uint32_t set, uint32_t out, uint32_t out1)
+{
+    if (em->nfa->count >= REGEX_NFA_CAP) {
+        em->error = "pattern is too big";
+        return 0;
+    }
+    da_append(em->nfa, ((Regex_Nfa_State) {.kind = kind, .set = set, .out = out, .out1 = out1}));
+    return (uint32_t) em->nfa->count - 1;
+}
+
+// Appends b to a. has_a is false while a is still nothing.
+static void regex_chain(Regex_Emitter *em, bool *has_a, Regex_Frag *a, Regex_Frag b)
+{
+    if (*has_a) {
+        regex_patch(em->nfa, a->ends, b.start);
+        a->ends = b.ends;
+    } else {
+        *a = b;
+        *has_a = true;
+    }
+}
+
+static Regex_Frag regex_emit(Regex_Emitter *em, uint32_t node)
+{
+    Regex_Frag frag = {0};
+    if (em->error != NULL) return frag;
+    Regex_Node n = em->nodes->items[node];
+    switch (n.kind) {
+    case REGEX_EMPTY: {
+        uint32_t s = regex_state(em, REGEX_NFA_SPLIT, 0, REGEX_NONE, REGEX_NONE);
+        if (em->error != NULL) return frag;
+        frag.start = s;
+        frag.ends = regex_join(em->nfa, s << 1, s << 1 | 1);
+    } break;
+    case REGEX_BYTES: {
+        uint32_t s = regex_state(em, REGEX_NFA_SET, n.set, REGEX_NONE, REGEX_NONE);
+        frag.start = s;
+        frag.ends = s << 1;
+    } break;
+    case REGEX_CONCAT: {
+        size_t base = regex_spine(em->nodes, node, &em->spine);
+        size_t count = em->spine.count - base;
+        bool has_frag = false;
+        // NOTE: the spine goes from right to left, the reverse NFA wants just that
+        for (size_t i = 0; i < count && em->error == NULL; ++i) {
+            uint32_t item = em->spine.items[em->reverse ? base + i : base + count - 1 - i];
+            regex_chain(em, &has_frag, &frag, regex_emit(em, item));
+        }
+        em->spine.count = base;
+    } break;
+    case REGEX_ALT: {
+        size_t base = regex_spine(em->nodes, node, &em->spine);
+        size_t count = em->spine.count - base;
+        frag = regex_emit(em, em->spine.items[base]);
+        for (size_t i = 1; i < count && em->error == NULL; ++i) {
+            Regex_Frag alt = regex_emit(em, em->spine.items[base + i]);
+            uint32_t s = regex_state(em, REGEX_NFA_SPLIT, 0, frag.start, alt.start);
+            frag.start = s;
+            frag.ends = regex_join(em->nfa, frag.ends, alt.ends);
+        }
+        em->spine.count = base;
+    } break;
+    case REGEX_REPEAT: {
+        bool has_frag = false;
+        for (uint32_t i = 0; i < n.min && em->error == NULL; ++i) {
+            regex_chain(em, &has_frag, &frag, regex_emit(em, n.lhs));
+        }
+        if (n.max == REGEX_INFINITY) {
+            Regex_Frag body = regex_emit(em, n.lhs);
+            uint32_t s = regex_state(em, REGEX_NFA_SPLIT, 0, body.start, REGEX_NONE);
+            if (em->error != NULL) return frag;
+            regex_patch(em->nfa, body.ends, s);
+            regex_chain(em, &has_frag, &frag, (Regex_Frag) {.start = s, .ends = s << 1 | 1});
+        } else {
+            for (uint32_t i = n.min; i < n.max && em->error == NULL; ++i) {
+                Regex_Frag body = regex_emit(em, n.lhs);
+                uint32_t s = regex_state(em, REGEX_NFA_SPLIT, 0, body.start, REGEX_NONE);
+                if (em->error != NULL) return frag;
+                regex_chain(em, &has_frag, &frag, (Regex_Frag) {.start = s, .ends = regex_join(em->nfa, body.ends, s << 1 | 1)});
+            }
+        }
+        if (!has_frag && em->error == NULL) {
+            uint32_t s = regex_state(em, REGEX_NFA_SPLIT, 0, REGEX_NONE, REGEX_NONE);
+            if (em->error != NULL) return frag;
+            frag.start = s;
+            frag.ends = regex_join(em->nfa, s << 1, s << 1 | 1);
+        }
+    } break;
+    }
+    return frag;
+}
+
+static const char *regex_build_nfa(const Regex_Nodes *nodes, uint32_t root, bool reverse, Regex_Nfa *nfa)
+{
+    Regex_Emitter em = {.nodes = nodes, .nfa = nfa, .reverse = reverse};
+    Regex_Frag frag = regex_emit(&em, root);
+    uint32_t match = regex_state(&em, REGEX_NFA_MATCH, 0, REGEX_NONE, REGEX_NONE);
+    if (em.error == NULL) {
+        regex_patch(nfa, frag.ends, match);
+        nfa->start = frag.start;
+    }
+    free(em.spine.items);
+    return em.error;
+}
+
+// The DFAs
+
+static int regex_compare_ids(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static size_t regex_hash(const uint32_t *ids, size_t count)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < count; ++i) {
+        hash ^= ids[i];
+        hash *= 1099511628211ULL;
+    }
+    return (size_t) (hash ^ (hash >> 32));
+}
+
+// Adds the NFA states reachable from state without consuming anything to dfa->scratch.
+// Only the states that consume or match are kept, the splits are only passed through.
+static void regex_dfa_closure(Regex_Dfa *dfa, uint32_t state)
+{
+    da_append(&dfa->stack, state);
+    while (dfa->stack.count > 0) {
+        uint32_t s = dfa->stack.items[--dfa->stack.count];
+        if (dfa->marks[s] == dfa->mark) continue;
+        dfa->marks[s] = dfa->mark;
+        Regex_Nfa_State st = dfa->nfa->items[s];
+        if (st.kind == REGEX_NFA_SPLIT) {
+            da_append(&dfa->stack, st.out1);
+            da_append(&dfa->stack, st.out);
+        } else {
+            da_append(&dfa->scratch, s);
+        }
+    }
+}
+
+static void regex_dfa_mark(Regex_Dfa *dfa)
+{
+    dfa->mark += 1;
+    if (dfa->mark == 0) {
+        memset(dfa->marks, 0, dfa->nfa->count*sizeof(*dfa->marks));
+        dfa->mark = 1;
+    }
+}
+
+// The state with exactly the NFA states ids, or -1 if there is no room for another one
+static int32_t regex_dfa_state(Regex_Dfa *dfa, const uint32_t *ids, size_t count)
+{
+    size_t mask = 2*REGEX_DFA_CAP - 1;
+    size_t slot = regex_hash(ids, count) & mask;
+    for (;; slot = (slot + 1) & mask) {
+        int32_t state = dfa->table[slot];
+        if (state < 0) break;
+        size_t begin = dfa->members_begin[state];
+        size_t state_count = dfa->members_begin[state + 1] - begin;
+        if (state_count == count && memcmp(dfa->members.items + begin, ids, count*sizeof(*ids)) == 0) return state;
+    }
+    if (dfa->count >= REGEX_DFA_CAP) return -1;
+
+    if (dfa->count + 1 >= dfa->capacity) {
+        dfa->capacity = dfa->capacity == 0 ? 64 : dfa->capacity*2;
+        dfa->next = realloc(dfa->next, dfa->capacity*256*sizeof(*dfa->next));
+        dfa->flags = realloc(dfa->flags, dfa->capacity*sizeof(*dfa->flags));
+        dfa->members_begin = realloc(dfa->members_begin, (dfa->capacity + 1)*sizeof(*dfa->members_begin));
+        assert(dfa->next != NULL && dfa->flags != NULL && dfa->members_begin != NULL && "Buy more RAM lol");
+    }
+    int32_t state = (int32_t) dfa->count++;
+    memset(dfa->next + (size_t) state*256, 0xFF, 256*sizeof(*dfa->next));
+    dfa->flags[state] = count == 0 ? REGEX_DFA_EMPTY : 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (dfa->nfa->items[ids[i]].kind == REGEX_NFA_MATCH) dfa->flags[state] |= REGEX_DFA_ACCEPTING;
+    }
+    // NOTE: ids may point into members, so make room first
+    da_reserve(&dfa->members, dfa->members.count + count);
+    if (count > 0) memmove(dfa->members.items + dfa->members.count, ids, count*sizeof(*ids));
+    dfa->members.count += count;
+    dfa->members_begin[state + 1] = dfa->members.count;
+    dfa->table[slot] = state;
+    return state;
+}
+
+// Drops all the states but the start and the empty one
+static void regex_dfa_reset(Regex_Dfa *dfa)
+{
+    dfa->count = 0;
+    dfa->members.count = 0;
+    if (dfa->members_begin != NULL) dfa->members_begin[0] = 0;
+    memset(dfa->table, 0xFF, sizeof(dfa->table));
+    dfa->start = regex_dfa_state(dfa, dfa->start_members.items, dfa->start_members.count);
+    dfa->empty = regex_dfa_state(dfa, NULL, 0);
+}
+
+static void regex_dfa_init(Regex_Dfa *dfa, const Regex_Nfa *nfa, const Regex_Sets *sets, Regex_Restart restart)
+{
+    dfa->nfa = nfa;
+    dfa->sets = sets;
+    dfa->restart = restart;
+    dfa->marks = calloc(nfa->count, sizeof(*dfa->marks));
+    assert(dfa->marks != NULL && "Buy more RAM lol");
+    dfa->capacity = 64;
+    dfa->next = malloc(dfa->capacity*256*sizeof(*dfa->next));
+    dfa->flags = malloc(dfa->capacity*sizeof(*dfa->flags));
+    dfa->members_begin = malloc((dfa->capacity + 1)*sizeof(*dfa->members_begin));
+    assert(dfa->next != NULL && dfa->flags != NULL && dfa->members_begin != NULL && "Buy more RAM lol");
+
+    regex_dfa_mark(dfa);
+    regex_dfa_closure(dfa, nfa->start);
+    qsort(dfa->scratch.items, dfa->scratch.count, sizeof(*dfa->scratch.items), regex_compare_ids);
+    dfa->start_members.count = 0;
+    da_append_many(&dfa->start_members, dfa->scratch.items, dfa->scratch.count);
+    dfa->scratch.count = 0;
+    regex_dfa_reset(dfa);
+}
+
+static void regex_dfa_free(Regex_Dfa *dfa)
+{
+    free(dfa->next);
+    free(dfa->flags);
+    free(dfa->members_begin);
+    free(dfa->members.items);
+    free(dfa->start_members.items);
+    free(dfa->stack.items);
+    free(dfa->scratch.items);
+    free(dfa->marks);
+}
+
+static int32_t regex_dfa_step(Regex_Dfa *dfa, int32_t from, uint8_t x)
+{
+    regex_dfa_mark(dfa);
+    dfa->scratch.count = 0;
+    for (size_t i = dfa->members_begin[from]; i < dfa->members_begin[from + 1]; ++i) {
+        Regex_Nfa_State st = dfa->nfa->items[dfa->members.items[i]];
+        if (st.kind == REGEX_NFA_SET && regex_set_has(&dfa->sets->items[st.set], x)) {
+            regex_dfa_closure(dfa, st.out);
+        }
+    }
+    if (dfa->restart == REGEX_RESTART_ALWAYS || (dfa->restart == REGEX_RESTART_AFTER_NEWLINE && x == '\n')) {
+        regex_dfa_closure(dfa, dfa->nfa->start);
+    }
+    qsort(dfa->scratch.items, dfa->scratch.count, sizeof(*dfa->scratch.items), regex_compare_ids);
+
+    int32_t to = regex_dfa_state(dfa, dfa->scratch.items, dfa->scratch.count);
+    if (to < 0) {
+        // NOTE: from is dropped too, so this transition is not remembered
+        regex_dfa_reset(dfa);
+        to = regex_dfa_state(dfa, dfa->scratch.items, dfa->scratch.count);
+        assert(to >= 0);
+        return to;
+    }
+    dfa->next[(size_t) from*256 + x] = to;
+    return to;
+}
+
+static inline int32_t regex_dfa_next(Regex_Dfa *dfa, int32_t from, uint8_t x)
+{
+    int32_t to = dfa->next[(size_t) from*256 + x];
+    return to >= 0 ? to : regex_dfa_step(dfa, from, x);
+}
+
+static inline bool regex_dfa_accepting(const Regex_Dfa *dfa, int32_t state)
+{
+    return dfa->flags[state] & REGEX_DFA_ACCEPTING;
+}
+
+static inline bool regex_dfa_is_empty(const Regex_Dfa *dfa, int32_t state)
+{
+    return dfa->flags[state] & REGEX_DFA_EMPTY;
+}
+
+bool regex_compile(Regex *re, const char *pattern, size_t count, bool ignore_case)
+{
+    *re = (Regex) {0};
+    re->program = calloc(1, sizeof(*re->program));
+    assert(re->program != NULL && "Buy more RAM lol");
+    Regex_Program *prog = re->program;
+
+    if (count > 0 && pattern[0] == '^') {
+        re->anchor_begin = true;
+        pattern += 1;
+        count -= 1;
+    }
+    if (count > 0 && pattern[count - 1] == '$') {
+        size_t backslashes = 0;
+        while (backslashes + 1 < count && pattern[count - 2 - backslashes] == '\\') backslashes += 1;
+        if (backslashes%2 == 0) {
+            re->anchor_end = true;
+            count -= 1;
+        }
+    }
+
+    Regex_Parser p = {
+        .pattern = pattern,
+        .count = count,
+        .ignore_case = ignore_case,
+        .sets = &prog->sets,
+    };
+    uint32_t root = regex_parse_alt(&p);
+    if (p.error == NULL && p.pos < p.count) p.error = "unmatched )";
+    if (p.error == NULL) p.error = regex_build_nfa(&p.nodes, root, false, &prog->forward_nfa);
+    if (p.error == NULL) p.error = regex_build_nfa(&p.nodes, root, true, &prog->reverse_nfa);
+    if (p.error != NULL) {
+        re->error = p.error;
+        free(p.nodes.items);
+        return false;
+    }
+
+    Regex_Ids spine = {0};
+    String_Builder run = {0};
+    regex_literal(&p, root, &spine, &run, &re->literal);
+    regex_literal_break(&run, &re->literal);
+    // NOTE: a single byte is found too often to be worth stopping the DFA for
+    if (re->literal.count < 2) re->literal.count = 0;
+    free(spine.items);
+    free(run.items);
+    free(p.nodes.items);
+    searcher_init(&re->literal_searcher, re->literal.items, re->literal.count, ignore_case, false);
+
+    regex_dfa_init(&prog->forward, &prog->forward_nfa, &prog->sets, re->anchor_begin ? REGEX_RESTART_AFTER_NEWLINE : REGEX_RESTART_ALWAYS);
+    regex_dfa_init(&prog->reverse, &prog->reverse_nfa, &prog->sets, re->anchor_end ? REGEX_RESTART_NEVER : REGEX_RESTART_ALWAYS);
+    regex_dfa_init(&prog->anchored, &prog->forward_nfa, &prog->sets, REGEX_RESTART_NEVER);
+    return true;
+}
+
+void regex_free(Regex *re)
+{
+    Regex_Program *prog = re->program;
+    if (prog != NULL) {
+        regex_dfa_free(&prog->forward);
+        regex_dfa_free(&prog->reverse);
+        regex_dfa_free(&prog->anchored);
+        free(prog->forward_nfa.items);
+        free(prog->reverse_nfa.items);
+        free(prog->sets.items);
+        free(prog);
+    }
+    free(re->literal.items);
+    free(re->line_begins.items);
+    *re = (Regex) {0};
+}
+
+void regex_forget(Regex *re)
+{
+    re->line_buffer = NULL;
+}
+
+// Matching
+
+static bool regex_at_line_begin(const Buffer *b, size_t pos)
+{
+    return pos == 0 || buffer_at(b, pos - 1) == '\n';
+}
+
+// Position of the first '\n' at or after pos, or the end of the buffer
+static size_t regex_line_end(const Buffer *b, size_t pos)
+{
+    String_View chunk;
+    for (; pos < b->count; pos += chunk.count) {
+        chunk = buffer_chunk(b, pos);
+        const char *newline = memchr(chunk.data, '\n', chunk.count);
+        if (newline != NULL) return pos + (size_t) (newline - chunk.data);
+    }
+    return b->count;
+}
+
+// Beginning of the line of pos, but not before limit
+static size_t regex_line_begin(const Buffer *b, size_t pos, size_t limit)
+{
+    while (pos > limit) {
+        String_View chunk = buffer_chunk_before(b, pos);
+        size_t count = chunk.count < pos - limit ? chunk.count : pos - limit;
+        for (size_t i = 0; i < count; ++i) {
+            if (chunk.data[chunk.count - 1 - i] == '\n') return pos - i;
+        }
+        pos -= count;
+    }
+    return limit;
+}
+
+// Where the first match that begins at or after from ends. Only looks at the bytes up to limit,
+// which has to be the end of a line.
+static bool regex_first_end(Regex *re, const Buffer *b, size_t from, size_t limit, size_t *end)
+{
+    Regex_Dfa *dfa = &re->program->forward;
+    int32_t s = !re->anchor_begin || regex_at_line_begin(b, from) ? dfa->start : dfa->empty;
+    if (!re->anchor_end && regex_dfa_accepting(dfa, s)) {
+        *end = from;
+        return true;
+    }
+
+    String_View chunk;
+    for (size_t pos = from; pos < limit; pos += chunk.count) {
+        chunk = buffer_chunk(b, pos);
+        if (chunk.count > limit - pos) chunk.count = limit - pos;
+        for (size_t i = 0; i < chunk.count; ++i) {
+            uint8_t x = (uint8_t) chunk.data[i];
+            if (x == '\n' && re->anchor_end && regex_dfa_accepting(dfa, s)) {
+                *end = pos + i;
+                return true;
+            }
+            s = regex_dfa_next(dfa, s, x);
+            if (dfa->flags[s] == 0) continue;
+            if (!re->anchor_end && regex_dfa_accepting(dfa, s)) {
+                *end = pos + i + 1;
+                return true;
+            }
+            if (regex_dfa_is_empty(dfa, s)) {
+                // NOTE: only happens with ^, nothing can match before the next line
+                const char *newline = memchr(chunk.data + i + 1, '\n', chunk.count - i - 1);
+                if (newline == NULL) break;
+                i = (size_t) (newline - chunk.data) - 1;
+            }
+        }
+    }
+    if (re->anchor_end && regex_dfa_accepting(dfa, s)) {
+        *end = limit;
+        return true;
+    }
+    return false;
+}
+
+// Records where the matches within [from, end] begin in re->line_begins. end has to be the end of a
+// line. Returns where the recorded begins start, which is the beginning of that line if it is after from.
+static size_t regex_line_begins(Regex *re, const Buffer *b, size_t from, size_t end)
+{
+    Regex_Dfa *dfa = &re->program->reverse;
+    Regex_Begins *begins = &re->line_begins;
+    begins->count = 0;
+    int32_t s = dfa->start;
+    if (regex_dfa_accepting(dfa, s) && (!re->anchor_begin || regex_at_line_begin(b, end))) {
+        da_append(begins, end);
+    }
+
+    size_t pos = end;
+    bool done = false;
+    while (!done && pos > from) {
+        String_View chunk = buffer_chunk_before(b, pos);
+        size_t count = chunk.count < pos - from ? chunk.count : pos - from;
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t x = (uint8_t) chunk.data[chunk.count - 1 - i];
+            if (x == '\n') {
+                from = pos - i;
+                done = true;
+                break;
+            }
+            s = regex_dfa_next(dfa, s, x);
+            size_t at = pos - 1 - i;
+            if (regex_dfa_accepting(dfa, s) && (!re->anchor_begin || regex_at_line_begin(b, at))) {
+                da_append(begins, at);
+            }
+            if (dfa->restart == REGEX_RESTART_NEVER && regex_dfa_is_empty(dfa, s)) {
+                done = true;
+                break;
+            }
+        }
+        pos -= count;
+    }
+
+    // NOTE: they were found going backwards
+    for (size_t i = 0, j = begins->count; i + 1 < j; ++i, --j) {
+        size_t t = begins->items[i];
+        begins->items[i] = begins->items[j - 1];
+        begins->items[j - 1] = t;
+    }
+    return from;
+}
+
+// Where the longest match that begins at begin ends. limit has to be the end of its line.
+static size_t regex_longest_end(Regex *re, const Buffer *b, size_t begin, size_t limit)
+{
+    Regex_Dfa *dfa = &re->program->anchored;
+    int32_t s = dfa->start;
+    size_t end = begin;
+
+    String_View chunk;
+    for (size_t pos = begin; pos < limit; pos += chunk.count) {
+        chunk = buffer_chunk(b, pos);
+        if (chunk.count > limit - pos) chunk.count = limit - pos;
+        for (size_t i = 0; i < chunk.count; ++i) {
+            s = regex_dfa_next(dfa, s, (uint8_t) chunk.data[i]);
+            if (regex_dfa_is_empty(dfa, s)) return end;
+            if (regex_dfa_accepting(dfa, s) && (!re->anchor_end || pos + i + 1 == limit)) end = pos + i + 1;
+        }
+    }
+    return end;
+}
+
+bool regex_next(Regex *re, const Buffer *b, size_t from, size_t *begin, size_t *end)
+{
+    if (re->error != NULL) return false;
+
+    if (re->line_buffer == b && from >= re->line_from && from <= re->line_end) {
+        const Regex_Begins *begins = &re->line_begins;
+        size_t lo = 0, hi = begins->count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo)/2;
+            if (begins->items[mid] < from) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < begins->count) {
+            *begin = begins->items[lo];
+            *end = regex_longest_end(re, b, *begin, re->line_end);
+            return true;
+        }
+        // Nothing else on this line
+        from = re->line_end + 1;
+    }
+
+    size_t pos = from;
+    size_t first_end;
+    for (;;) {
+        if (pos > b->count) return false;
+        if (re->literal.count > 0) {
+            size_t hit;
+            if (!search_next(&re->literal_searcher, b, pos, &hit)) return false;
+            // NOTE: matches don't span lines, so a match with the literal is on the literal's line
+            size_t line_begin = regex_line_begin(b, hit, pos);
+            size_t line_end = regex_line_end(b, hit);
+            if (regex_first_end(re, b, line_begin, line_end, &first_end)) {
+                pos = line_begin;
+                break;
+            }
+            pos = line_end + 1;
+        } else if (regex_first_end(re, b, pos, b->count, &first_end)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+
+    // The first match to end is not necessarily the one that begins first, but that one is on its line.
+    // Going back over the line finds where all of its matches begin at once.
+    size_t line_end = regex_line_end(b, first_end);
+    re->line_from = regex_line_begins(re, b, pos, line_end);
+    re->line_end = line_end;
+    re->line_buffer = b;
+    assert(re->line_begins.count > 0);
+    *begin = re->line_begins.items[0];
+    *end = regex_longest_end(re, b, *begin, line_end);
+    return true;
+}
+
+void matches_find_regex(Matches *m, Regex *re, const Buffer *b)
+{
+    m->count = 0;
+    m->end = b->count;
+    size_t pos = 0;
+    size_t begin, end;
+    while (regex_next(re, b, pos, &begin, &end)) {
+        if (m->count >= MATCHES_CAP) {
+            m->end = begin;
+            return;
+        }
+        da_append(m, begin);
+        pos = end > begin ? end : begin + 1;
+    }
+}
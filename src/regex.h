@@ -0,0 +1,60 @@
+#ifndef REGEX_H_
+#define REGEX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "./buffer.h"
+#include "./search.h"
+
+// Regular expressions matched with a DFA that is built as the text needs it. There is no
+// backtracking and no captures, finding a match takes time linear in the text up to it and
+// the rest of its line no matter the pattern. Where all the matches on that line begin is found
+// in the same pass and kept, so stepping through them doesn't go over the line again.
+//
+// Syntax: literal bytes, . [abc] [^a-z] \d \w \s \D \W \S, escapes like \. \\ \t, grouping with
+// (...) or (?:...), | and the repetitions * + ? {n} {n,} {n,m}. ^ and $ anchor the whole pattern
+// to the beginning and the end of a line and may only be its first and last byte. Matches never
+// span lines, nothing matches '\n'. Among the matches that begin first the longest one wins.
+
+// The most NFA states a pattern may compile to, which {n,m} multiplies quickly
+#define REGEX_NFA_CAP (64*1024)
+// The most DFA states kept at once, a power of two. When there are more, they are all dropped
+// and built again.
+#define REGEX_DFA_CAP 2048
+
+// The automata, private to regex.c
+typedef struct Regex_Program Regex_Program;
+
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+} Regex_Begins;
+
+typedef struct {
+    const char *error;       // why compiling failed
+    bool anchor_begin;
+    bool anchor_end;
+    String_Builder literal;  // every match contains it, found with literal_searcher before running the DFA
+    Searcher literal_searcher;
+    Regex_Program *program;
+
+    // The line regex_next() found a match on last
+    const Buffer *line_buffer; // NULL if there is none
+    size_t line_from;          // the begins are known from here to line_end
+    size_t line_end;
+    Regex_Begins line_begins;  // of the matches in ascending order
+} Regex;
+
+// Returns false and sets re->error if the pattern is not valid. Either way, free it with regex_free().
+bool regex_compile(Regex *re, const char *pattern, size_t count, bool ignore_case);
+void regex_free(Regex *re);
+// Finds the leftmost longest match that begins at or after from. A pattern that did not compile
+// matches nothing.
+bool regex_next(Regex *re, const Buffer *b, size_t from, size_t *begin, size_t *end);
+// Drops what regex_next() keeps about the line it went over last. Call it once the text changes.
+void regex_forget(Regex *re);
+// Records the matches of re in b from the beginning like matches_find(). They don't overlap.
+void matches_find_regex(Matches *m, Regex *re, const Buffer *b);
+
+#endif // REGEX_H_
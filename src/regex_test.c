@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./regex.h"
+
+// A single line with a match every 8 bytes. Going over the rest of the line for every match
+// takes minutes for a line this long, regex_next() has to go over it only once.
+#define LONG_LINE_SIZE (1024*1024)
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures += 1;
+    }
+}
+
+static void test_long_line(void)
+{
+    char *text = malloc(LONG_LINE_SIZE + 2);
+    if (text == NULL) {
+        fprintf(stderr, "Buy more RAM lol\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < LONG_LINE_SIZE; ++i) {
+        text[i] = i%8 == 7 ? (char) ('0' + (i/8)%10) : 'x';
+    }
+    // NOTE: the next line has a match too, so the search has to get past the end of the long one
+    memcpy(text + LONG_LINE_SIZE, "\n7", 2);
+
+    Buffer b = {0};
+    buffer_insert(&b, 0, text, LONG_LINE_SIZE + 2);
+
+    Regex re;
+    expect(regex_compile(&re, "[0-9]", 5, false), "[0-9] compiles");
+
+    Matches m = {0};
+    matches_find_regex(&m, &re, &b);
+    expect(m.count == LONG_LINE_SIZE/8 + 1, "every digit of the long line is found once");
+    bool in_place = true;
+    for (size_t i = 0; i < m.count && i < LONG_LINE_SIZE/8; ++i) {
+        if (m.items[i] != i*8 + 7) in_place = false;
+    }
+    expect(in_place, "the matches of the long line are where the digits are");
+    expect(m.count > 0 && m.items[m.count - 1] == LONG_LINE_SIZE + 1, "the match on the next line is found");
+
+    // Going back into the line it already went over
+    size_t begin, end;
+    expect(regex_next(&re, &b, 12, &begin, &end) && begin == 15 && end == 16, "a match is found again from before it");
+
+    regex_forget(&re);
+    buffer_delete(&b, 0, 8);
+    expect(regex_next(&re, &b, 0, &begin, &end) && begin == 7 && end == 8, "the text is searched again once it changed");
+
+    free(m.items);
+    regex_free(&re);
+    buffer_clear(&b);
+    free(b.pieces.items);
+    free(text);
+}
+
+static void test_many_matches_per_line(void)
+{
+    const char *text = "ab aab b\naaab\n\nab";
+    Buffer b = {0};
+    buffer_insert(&b, 0, text, strlen(text));
+
+    Regex re;
+    expect(regex_compile(&re, "a*b", 3, false), "a*b compiles");
+    size_t expected[][2] = {{0, 2}, {3, 6}, {7, 8}, {9, 13}, {15, 17}};
+    size_t count = sizeof(expected)/sizeof(expected[0]);
+    size_t pos = 0;
+    size_t found = 0;
+    size_t begin, end;
+    while (regex_next(&re, &b, pos, &begin, &end)) {
+        if (found < count) {
+            expect(begin == expected[found][0] && end == expected[found][1], "a*b matches the longest run from the leftmost begin");
+        }
+        found += 1;
+        pos = end > begin ? end : begin + 1;
+    }
+    expect(found == count, "a*b finds all of its matches");
+
+    regex_free(&re);
+    buffer_clear(&b);
+    free(b.pieces.items);
+}
+
+int main(void)
+{
+    test_long_line();
+    test_many_matches_per_line();
+    if (failures > 0) return 1;
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include "./scan.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#    define SCAN_SSE2
+#    include <emmintrin.h>
+#    if defined(__GNUC__) || defined(__clang__)
+#        define SCAN_AVX2
+#        include <immintrin.h>
+#    endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#    define scan_ctz32(x) ((size_t) __builtin_ctz(x))
+#elif defined(_MSC_VER)
+#    include <intrin.h>
+static inline size_t scan_ctz32(uint32_t x)
+{
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return index;
+}
+#endif
+
+// Turns a bit mask of matches at data[base..base+32) into offsets
+#define SCAN_EMIT_MASK(mask, base, out, n)                          \
+    do {                                                            \
+        uint32_t m = (mask);                                        \
+        while (m) {                                                 \
+            (out)[(n)++] = (uint32_t) ((base) + scan_ctz32(m));     \
+            m &= m - 1;                                             \
+        }                                                           \
+    } while (0)
+
+static size_t scan_newlines_scalar(const char *data, size_t size, uint32_t *out)
+{
+    size_t n = 0;
+    const char *it = data;
+    const char *end = data + size;
+    while ((it = memchr(it, '\n', end - it)) != NULL) {
+        out[n++] = (uint32_t) (it - data);
+        it += 1;
+    }
+    return n;
+}
+
+#ifdef SCAN_SSE2
+static size_t scan_newlines_sse2(const char *data, size_t size, uint32_t *out)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t n = 0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (data + i + 16));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(a, nl))
+                     | ((uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(b, nl)) << 16);
+        SCAN_EMIT_MASK(mask, i, out, n);
+    }
+    for (; i < size; ++i) {
+        if (data[i] == '\n') out[n++] = (uint32_t) i;
+    }
+    return n;
+}
+#endif // SCAN_SSE2
+
+#ifdef SCAN_AVX2
+__attribute__((target("avx2")))
+static size_t scan_newlines_avx2(const char *data, size_t size, uint32_t *out)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t n = 0;
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (data + i + 32));
+        uint32_t mask_a = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, nl));
+        uint32_t mask_b = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(b, nl));
+        // Skip the bit extraction entirely for the common case of a long line
+        if ((mask_a | mask_b) == 0) continue;
+        SCAN_EMIT_MASK(mask_a, i, out, n);
+        SCAN_EMIT_MASK(mask_b, i + 32, out, n);
+    }
+    for (; i < size; ++i) {
+        if (data[i] == '\n') out[n++] = (uint32_t) i;
+    }
+    return n;
+}
+#endif // SCAN_AVX2
+
+typedef size_t (*Scan_Newlines)(const char *data, size_t size, uint32_t *out);
+
+// Written once by scan_init() before any other thread scans
+static Scan_Newlines scan_newlines_impl = NULL;
+
+void scan_init(void)
+{
+    if (scan_newlines_impl != NULL) return;
+
+    Scan_Newlines impl = scan_newlines_scalar;
+#ifdef SCAN_SSE2
+    impl = scan_newlines_sse2;
+#endif // SCAN_SSE2
+#ifdef SCAN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        impl = scan_newlines_avx2;
+    }
+#endif // SCAN_AVX2
+    scan_newlines_impl = impl;
+}
+
+size_t scan_newlines(const char *data, size_t size, uint32_t *out)
+{
+    assert(size <= SCAN_BLOCK_SIZE);
+    assert(scan_newlines_impl != NULL && "scan_init() was not called");
+    return scan_newlines_impl(data, size, out);
+}
+
+// The run kernels below only need SSE2, which every x86-64 has, so they are not dispatched
+
+size_t scan_until3(const char *data, size_t size, char a, char b, char c)
+{
+    size_t i = 0;
+#ifdef SCAN_SSE2
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vc));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(eq);
+        if (mask != 0) return i + scan_ctz32(mask);
+    }
+#endif // SCAN_SSE2
+    for (; i < size; ++i) {
+        if (data[i] == a || data[i] == b || data[i] == c) return i;
+    }
+    return size;
+}
+
+size_t scan_blanks(const char *data, size_t size)
+{
+    size_t i = 0;
+#ifdef SCAN_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab));
+        uint32_t mask = ~(uint32_t) _mm_movemask_epi8(blank) & 0xFFFF;
+        if (mask != 0) return i + scan_ctz32(mask);
+    }
+#endif // SCAN_SSE2
+    for (; i < size; ++i) {
+        if (data[i] != ' ' && data[i] != '\t') return i;
+    }
+    return size;
+}
+
+size_t scan_pair(const char *data, size_t size, char a, char b, size_t distance, bool fold_case)
+{
+    if (size <= distance) return size;
+    size_t count = size - distance;
+    // NOTE: setting the case bit maps exactly the two cases of a letter onto its lowercase
+    const char fold_a = fold_case && a >= 'a' && a <= 'z' ? 0x20 : 0;
+    const char fold_b = fold_case && b >= 'a' && b <= 'z' ? 0x20 : 0;
+    size_t i = 0;
+#ifdef SCAN_SSE2
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vfold_a = _mm_set1_epi8(fold_a);
+    const __m128i vfold_b = _mm_set1_epi8(fold_b);
+    for (; i + 16 <= count; i += 16) {
+        __m128i first = _mm_or_si128(_mm_loadu_si128((const __m128i *) (data + i)), vfold_a);
+        __m128i last = _mm_or_si128(_mm_loadu_si128((const __m128i *) (data + i + distance)), vfold_b);
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, va), _mm_cmpeq_epi8(last, vb));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(eq);
+        if (mask != 0) return i + scan_ctz32(mask);
+    }
+#endif // SCAN_SSE2
+    for (; i < count; ++i) {
+        if ((data[i] | fold_a) == a && (data[i + distance] | fold_b) == b) return i;
+    }
+    return size;
+}
@@ -0,0 +1,30 @@
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Vectorized byte scanning kernels. Every kernel has a scalar version and an SSE2
+// version on x86. scan_newlines() also has an AVX2 one that is picked at runtime.
+
+// Picks the scan_newlines() kernel for this CPU. Call it on the main thread before anything scans,
+// calling it again does nothing.
+void scan_init(void);
+
+// The biggest block scan_newlines() accepts at once
+#define SCAN_BLOCK_SIZE (8*1024)
+
+// Stores the offsets of all '\n' in data[0..size) into out in ascending order and returns
+// their amount. size must not exceed SCAN_BLOCK_SIZE and out must have room for size entries.
+size_t scan_newlines(const char *data, size_t size, uint32_t *out);
+
+// Offset of the first byte that is a, b or c, or size if there is none.
+size_t scan_until3(const char *data, size_t size, char a, char b, char c);
+// Length of the run of spaces and tabs at the beginning of data.
+size_t scan_blanks(const char *data, size_t size);
+// Offset of the first i with data[i] == a and data[i + distance] == b, or size if there is none.
+// With fold_case ASCII letters match in either case, a and b have to be lowercase then.
+size_t scan_pair(const char *data, size_t size, char a, char b, size_t distance, bool fold_case);
+
+#endif // SCAN_H_
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "./common.h"
+// NOTE: the kernels are private to scan.c, the benchmark times each of them
+#include "./scan.c"
+
+// Without a file the benchmark makes up this much text with lines of 0 to 80 bytes
+#define BENCH_TEXT_SIZE (64*1024*1024)
+// Every kernel goes over at least this many bytes
+#define BENCH_BYTES_MIN (1024ull*1024*1024)
+
+// The loop that scanned for newlines before scan_newlines()
+static size_t newlines_loop(const char *data, size_t size, uint32_t *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '\n') out[n++] = (uint32_t) i;
+    }
+    return n;
+}
+
+static void bench(const char *name, Scan_Newlines kernel, const char *data, size_t size)
+{
+    static uint32_t newlines[SCAN_BLOCK_SIZE];
+    size_t passes = (BENCH_BYTES_MIN + size - 1)/size;
+    size_t count = 0;
+    clock_t begin = clock();
+    for (size_t pass = 0; pass < passes; ++pass) {
+        // The same blocks lines_scan() feeds it
+        for (size_t pos = 0; pos < size; pos += SCAN_BLOCK_SIZE) {
+            size_t block = size - pos < SCAN_BLOCK_SIZE ? size - pos : SCAN_BLOCK_SIZE;
+            count += kernel(data + pos, block, newlines);
+        }
+    }
+    double secs = (double) (clock() - begin)/CLOCKS_PER_SEC;
+    printf("%-10s %6.2f GB/s  %zu newlines\n", name, (double) size*passes/secs/1e9, count/passes);
+}
+
+int main(int argc, char **argv)
+{
+    String_Builder text = {0};
+    if (argc > 1) {
+        Errno err = read_entire_file(argv[1], &text);
+        if (err != 0) {
+            fprintf(stderr, "ERROR: Could not read file %s: %s\n", argv[1], strerror(err));
+            return 1;
+        }
+    } else {
+        unsigned seed = 69;
+        size_t line = 0;
+        for (size_t i = 0; i < BENCH_TEXT_SIZE; ++i) {
+            seed = seed*1103515245 + 12345;
+            if (line == 0) line = (seed >> 16)%81 + 1;
+            line -= 1;
+            da_append(&text, line == 0 ? '\n' : (char) ('a' + (seed >> 16)%26));
+        }
+    }
+    if (text.count == 0) {
+        fprintf(stderr, "ERROR: Nothing to scan\n");
+        return 1;
+    }
+
+    scan_init();
+    printf("%zu bytes\n", text.count);
+    bench("byte loop", newlines_loop, text.items, text.count);
+    bench("memchr", scan_newlines_scalar, text.items, text.count);
+#ifdef SCAN_SSE2
+    bench("SSE2", scan_newlines_sse2, text.items, text.count);
+#endif // SCAN_SSE2
+#ifdef SCAN_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        bench("AVX2", scan_newlines_avx2, text.items, text.count);
+    }
+#endif // SCAN_AVX2
+
+    free(text.items);
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+// NOTE: the kernels are private to scan.c, every one of them is checked and not only the one this
+// CPU picks
+#include "./scan.c"
+
+// Long enough for a few full 64 byte steps and every tail after them
+#define TEST_SIZE_MAX 200
+#define TEST_ROUNDS 2000
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures += 1;
+    }
+}
+
+static unsigned seed = 69;
+
+static unsigned test_random(void)
+{
+    seed = seed*1103515245 + 12345;
+    return seed >> 16;
+}
+
+// Mostly letters with the bytes the kernels look for sprinkled in at the given rate
+static void test_fill(char *data, size_t size, unsigned rate)
+{
+    const char special[] = {'\n', ' ', '\t', '"', '\\', 'a', 'A', 'b', 'B'};
+    for (size_t i = 0; i < size; ++i) {
+        if (test_random()%100 < rate) {
+            data[i] = special[test_random()%sizeof(special)];
+        } else {
+            data[i] = (char) ('c' + test_random()%20);
+        }
+    }
+}
+
+static size_t newlines_loop(const char *data, size_t size, uint32_t *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '\n') out[n++] = (uint32_t) i;
+    }
+    return n;
+}
+
+static void test_newlines_kernel(Scan_Newlines kernel, const char *name, const char *data, size_t size)
+{
+    static uint32_t expected[SCAN_BLOCK_SIZE];
+    static uint32_t actual[SCAN_BLOCK_SIZE];
+    size_t n = newlines_loop(data, size, expected);
+    size_t m = kernel(data, size, actual);
+    if (n != m || memcmp(expected, actual, n*sizeof(*expected)) != 0) {
+        fprintf(stderr, "FAILED: %s finds the newlines of %zu bytes\n", name, size);
+        failures += 1;
+    }
+}
+
+static void test_newlines(const char *data, size_t size)
+{
+    test_newlines_kernel(scan_newlines_scalar, "scan_newlines_scalar", data, size);
+#ifdef SCAN_SSE2
+    test_newlines_kernel(scan_newlines_sse2, "scan_newlines_sse2", data, size);
+#endif // SCAN_SSE2
+#ifdef SCAN_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        test_newlines_kernel(scan_newlines_avx2, "scan_newlines_avx2", data, size);
+    }
+#endif // SCAN_AVX2
+    test_newlines_kernel(scan_newlines, "scan_newlines", data, size);
+}
+
+static void test_runs(const char *data, size_t size)
+{
+    size_t expected = size;
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '"' || data[i] == '\\' || data[i] == '\n') {
+            expected = i;
+            break;
+        }
+    }
+    expect(scan_until3(data, size, '"', '\\', '\n') == expected, "scan_until3 stops where the byte loop does");
+
+    expected = size;
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] != ' ' && data[i] != '\t') {
+            expected = i;
+            break;
+        }
+    }
+    expect(scan_blanks(data, size) == expected, "scan_blanks stops where the byte loop does");
+
+    for (size_t distance = 0; distance < 40; distance += 1 + distance/4) {
+        for (int fold_case = 0; fold_case <= 1; ++fold_case) {
+            char a = test_random()%2 ? 'a' : 'b';
+            char b = test_random()%2 ? 'a' : '\t';
+            expected = size;
+            for (size_t i = 0; i + distance < size; ++i) {
+                char x = data[i];
+                char y = data[i + distance];
+                if (fold_case && x >= 'A' && x <= 'Z') x += 'a' - 'A';
+                if (fold_case && y >= 'A' && y <= 'Z') y += 'a' - 'A';
+                if (x == a && y == b) {
+                    expected = i;
+                    break;
+                }
+            }
+            expect(scan_pair(data, size, a, b, distance, fold_case) == expected, "scan_pair stops where the byte loop does");
+        }
+    }
+}
+
+int main(void)
+{
+    scan_init();
+
+    static char block[SCAN_BLOCK_SIZE + 64];
+    for (size_t round = 0; round < TEST_ROUNDS; ++round) {
+        size_t size = test_random()%(TEST_SIZE_MAX + 1);
+        // NOTE: the offset makes the loads unaligned in every way
+        size_t offset = test_random()%64;
+        unsigned rate = (unsigned[]) {0, 2, 10, 50, 100}[round%5];
+        test_fill(block + offset, size, rate);
+        test_newlines(block + offset, size);
+        test_runs(block + offset, size);
+    }
+
+    // Whole blocks, sparse and full of newlines
+    test_fill(block, SCAN_BLOCK_SIZE, 5);
+    test_newlines(block, SCAN_BLOCK_SIZE);
+    memset(block, '\n', SCAN_BLOCK_SIZE);
+    test_newlines(block, SCAN_BLOCK_SIZE);
+
+    if (failures > 0) return 1;
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <assert.h>
+#include <string.h>
+#include "./scan.h"
+#include "./search.h"
+
+static inline char search_fold(char x)
+{
+    return x >= 'A' && x <= 'Z' ? x | 0x20 : x;
+}
+
+static inline bool search_is_word(char x)
+{
+    return (x >= 'a' && x <= 'z') || (x >= 'A' && x <= 'Z') || (x >= '0' && x <= '9') || x == '_';
+}
+
+static bool search_equal(const Searcher *s, const char *needle, const char *data, size_t count)
+{
+    if (!s->ignore_case) return memcmp(needle, data, count) == 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (search_fold(needle[i]) != search_fold(data[i])) return false;
+    }
+    return true;
+}
+
+// How rare the byte is in text, higher is rarer
+static int search_rarity(char x)
+{
+    if (x == ' ' || x == '\t' || x == '\n') return 0;
+    if ((x >= 'a' && x <= 'z') || x == '_') return 1;
+    return 2;
+}
+
+void searcher_init(Searcher *s, const char *needle, size_t count, bool ignore_case, bool whole_word)
+{
+    s->needle = needle;
+    s->count = count;
+    s->ignore_case = ignore_case;
+    s->whole_word = whole_word;
+
+    // NOTE: the first and the last byte unless the needle has rarer ones, then the rarest bytes
+    // closest to the ends. A pair of spaces is a candidate at almost every position of code.
+    s->probe_a = 0;
+    s->probe_b = count > 0 ? count - 1 : 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (search_rarity(needle[i]) > search_rarity(needle[s->probe_a])) s->probe_a = i;
+    }
+    for (size_t i = count; i-- > 0;) {
+        if (i != s->probe_a && (s->probe_b == s->probe_a || search_rarity(needle[i]) > search_rarity(needle[s->probe_b]))) s->probe_b = i;
+    }
+    if (s->probe_a > s->probe_b) {
+        size_t t = s->probe_a;
+        s->probe_a = s->probe_b;
+        s->probe_b = t;
+    }
+}
+
+static bool search_at_word_bounds(const Searcher *s, const Buffer *b, size_t pos)
+{
+    if (pos > 0 && search_is_word(buffer_at(b, pos - 1))) return false;
+    if (pos + s->count < b->count && search_is_word(buffer_at(b, pos + s->count))) return false;
+    return true;
+}
+
+bool search_matches_at(const Searcher *s, const Buffer *b, size_t pos)
+{
+    if (pos > b->count || b->count - pos < s->count) return false;
+    for (size_t i = 0; i < s->count;) {
+        String_View chunk = buffer_chunk(b, pos + i);
+        size_t n = chunk.count < s->count - i ? chunk.count : s->count - i;
+        if (!search_equal(s, s->needle + i, chunk.data, n)) return false;
+        i += n;
+    }
+    return !s->whole_word || search_at_word_bounds(s, b, pos);
+}
+
+// Offset of the first match at or after from that lies entirely within data[0..size), or size
+static size_t search_in(const Searcher *s, const char *data, size_t size, size_t from)
+{
+    size_t n = s->count;
+    char a = s->ignore_case ? search_fold(s->needle[s->probe_a]) : s->needle[s->probe_a];
+    char b = s->ignore_case ? search_fold(s->needle[s->probe_b]) : s->needle[s->probe_b];
+    if (size < n) return size;
+    // The candidates are the positions where both probes match, the rest of the needle is compared after
+    const char *probes = data + s->probe_a;
+    size_t probes_size = size - (n - 1) + (s->probe_b - s->probe_a);
+    for (size_t i = from; i + n <= size; ++i) {
+        size_t k = scan_pair(probes + i, probes_size - i, a, b, s->probe_b - s->probe_a, s->ignore_case);
+        if (k == probes_size - i) break;
+        i += k;
+        if (search_equal(s, s->needle, data + i, n)) return i;
+    }
+    return size;
+}
+
+bool search_next(const Searcher *s, const Buffer *b, size_t from, size_t *pos)
+{
+    if (s->count == 0) {
+        *pos = from;
+        return from <= b->count;
+    }
+
+    String_View chunk;
+    for (size_t begin = from; begin < b->count; begin += chunk.count) {
+        chunk = buffer_chunk(b, begin);
+
+        // The matches within the piece
+        for (size_t i = 0; (i = search_in(s, chunk.data, chunk.count, i)) < chunk.count; ++i) {
+            if (!s->whole_word || search_at_word_bounds(s, b, begin + i)) {
+                *pos = begin + i;
+                return true;
+            }
+        }
+
+        // The matches that continue into the next pieces
+        size_t end = begin + chunk.count;
+        size_t straddle = chunk.count >= s->count ? end - s->count + 1 : begin;
+        for (size_t p = straddle; p < end; ++p) {
+            if (search_matches_at(s, b, p)) {
+                *pos = p;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void matches_find(Matches *m, const Searcher *s, const Buffer *b)
+{
+    assert(s->count > 0);
+    m->count = 0;
+    m->end = b->count;
+    size_t pos = 0;
+    while (search_next(s, b, pos, &pos)) {
+        if (m->count >= MATCHES_CAP) {
+            m->end = pos;
+            return;
+        }
+        da_append(m, pos);
+        pos += 1;
+    }
+}
+
+void matches_narrow(Matches *m, const Searcher *s, const Buffer *b)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < m->count; ++i) {
+        if (search_matches_at(s, b, m->items[i])) m->items[count++] = m->items[i];
+    }
+    m->count = count;
+}
+
+size_t matches_lower_bound(const Matches *m, size_t pos)
+{
+    size_t lo = 0;
+    size_t hi = m->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (m->items[mid] < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
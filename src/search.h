@@ -0,0 +1,42 @@
+#ifndef SEARCH_H_
+#define SEARCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "./buffer.h"
+
+// A needle prepared for searching. It points to the needle, which has to outlive it.
+typedef struct {
+    const char *needle;
+    size_t count;
+    bool ignore_case;         // ASCII letters match in either case
+    bool whole_word;          // matches may not have [A-Za-z0-9_] right before or after them
+    size_t probe_a;           // the two bytes of the needle scan_pair() looks for,
+    size_t probe_b;           // probe_a <= probe_b, picked to be rare in text
+} Searcher;
+
+void searcher_init(Searcher *s, const char *needle, size_t count, bool ignore_case, bool whole_word);
+bool search_matches_at(const Searcher *s, const Buffer *b, size_t pos);
+// Finds the first match that begins at or after from. An empty needle matches everywhere.
+bool search_next(const Searcher *s, const Buffer *b, size_t from, size_t *pos);
+
+// Stop recording matches after this many. The ones past them are looked for on demand.
+#define MATCHES_CAP (1024*1024)
+
+// The offsets of the matches of a needle in ascending order
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+    size_t end;               // every match that begins before end is in items, the rest were not looked for
+} Matches;
+
+// Records the matches of s in b from the beginning
+void matches_find(Matches *m, const Searcher *s, const Buffer *b);
+// Keeps only the matches that are still matches of s. Only the needles that begin with the one m
+// was found for and have no more matches than it can be narrowed down to, so no whole words.
+void matches_narrow(Matches *m, const Searcher *s, const Buffer *b);
+// Index of the first match that begins at or after pos
+size_t matches_lower_bound(const Matches *m, size_t pos);
+
+#endif // SEARCH_H_
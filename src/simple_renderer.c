@@ -8,6 +8,7 @@
 #include "./common.h"
 
 #define vert_shader_file_path "./shaders/simple.vert"
+#define glyph_vert_shader_file_path "./shaders/simple_glyph.vert"
 
 static_assert(COUNT_SIMPLE_SHADERS == 4, "The amount of fragment shaders has changed");
 const char *frag_shader_file_paths[COUNT_SIMPLE_SHADERS] = {
@@ -128,6 +129,38 @@ static void get_uniform_location(GLuint program, GLint locations[COUNT_UNIFORM_S
     }
 }
 
+// Links the vertex shader with each of the fragment shaders. The programs are created even if it fails.
+static bool link_programs(const char *vert_file_path, GLuint programs[COUNT_SIMPLE_SHADERS])
+{
+    GLuint shaders[2] = {0};
+
+    bool ok = true;
+
+    if (!compile_shader_file(vert_file_path, GL_VERTEX_SHADER, &shaders[0])) {
+        ok = false;
+    }
+
+    for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i) {
+        if (!compile_shader_file(frag_shader_file_paths[i], GL_FRAGMENT_SHADER, &shaders[1])) {
+            ok = false;
+        }
+        programs[i] = glCreateProgram();
+        attach_shaders_to_program(shaders, sizeof(shaders) / sizeof(shaders[0]), programs[i]);
+        if (!link_program(programs[i], __FILE__, __LINE__)) {
+            ok = false;
+        } else {
+            GLuint glyphs_block = glGetUniformBlockIndex(programs[i], "Glyphs");
+            if (glyphs_block != GL_INVALID_INDEX) {
+                glUniformBlockBinding(programs[i], glyphs_block, SIMPLE_GLYPHS_BINDING);
+            }
+        }
+        glDeleteShader(shaders[1]);
+    }
+    glDeleteShader(shaders[0]);
+
+    return ok;
+}
+
 void simple_renderer_init(Simple_Renderer *sr)
 {
     sr->camera_scale = 3.0f;
@@ -138,7 +171,7 @@ void simple_renderer_init(Simple_Renderer *sr)
 
         glGenBuffers(1, &sr->vbo);
         glBindBuffer(GL_ARRAY_BUFFER, sr->vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(sr->verticies), sr->verticies, GL_DYNAMIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, SIMPLE_VERTICIES_CAP*sizeof(Simple_Vertex), NULL, GL_STREAM_DRAW);
 
         // position
         glEnableVertexAttribArray(SIMPLE_VERTEX_ATTR_POSITION);
@@ -155,8 +188,8 @@ void simple_renderer_init(Simple_Renderer *sr)
         glVertexAttribPointer(
             SIMPLE_VERTEX_ATTR_COLOR,
             4,
-            GL_FLOAT,
-            GL_FALSE,
+            GL_UNSIGNED_BYTE,
+            GL_TRUE,
             sizeof(Simple_Vertex),
             (GLvoid *) offsetof(Simple_Vertex, color));
 
@@ -165,98 +198,129 @@ void simple_renderer_init(Simple_Renderer *sr)
         glVertexAttribPointer(
             SIMPLE_VERTEX_ATTR_UV,
             2,
-            GL_FLOAT,
-            GL_FALSE,
+            GL_UNSIGNED_SHORT,
+            GL_TRUE,
             sizeof(Simple_Vertex),
             (GLvoid *) offsetof(Simple_Vertex, uv));
     }
 
-    GLuint shaders[2] = {0};
+    {
+        glGenVertexArrays(1, &sr->glyphs_vao);
+        glBindVertexArray(sr->glyphs_vao);
 
-    if (!compile_shader_file(vert_shader_file_path, GL_VERTEX_SHADER, &shaders[0])) {
-        exit(1);
+        glGenBuffers(1, &sr->glyphs_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, sr->glyphs_vbo);
+        glBufferData(GL_ARRAY_BUFFER, SIMPLE_GLYPHS_CAP*sizeof(Simple_Glyph), NULL, GL_STREAM_DRAW);
+
+        // NOTE: the pointers themselves are set by simple_renderer_draw_glyphs(), they depend on where the batch is
+        glEnableVertexAttribArray(SIMPLE_GLYPH_ATTR_POSITION);
+        glVertexAttribDivisor(SIMPLE_GLYPH_ATTR_POSITION, 1);
+        glEnableVertexAttribArray(SIMPLE_GLYPH_ATTR_COLOR);
+        glVertexAttribDivisor(SIMPLE_GLYPH_ATTR_COLOR, 1);
+        glEnableVertexAttribArray(SIMPLE_GLYPH_ATTR_GLYPH);
+        glVertexAttribDivisor(SIMPLE_GLYPH_ATTR_GLYPH, 1);
+
+        glBindVertexArray(sr->vao);
     }
 
-    for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i) {
-        if (!compile_shader_file(frag_shader_file_paths[i], GL_FRAGMENT_SHADER, &shaders[1])) {
-            exit(1);
-        }
-        sr->programs[i] = glCreateProgram();
-        attach_shaders_to_program(shaders, sizeof(shaders) / sizeof(shaders[0]), sr->programs[i]);
-        if (!link_program(sr->programs[i], __FILE__, __LINE__)) {
-            exit(1);
-        }
-        glDeleteShader(shaders[1]);
+    if (!link_programs(vert_shader_file_path, sr->programs)) {
+        exit(1);
+    }
+    if (!link_programs(glyph_vert_shader_file_path, sr->glyphs_programs)) {
+        exit(1);
     }
-    glDeleteShader(shaders[0]);
 }
 
 void simple_renderer_reload_shaders(Simple_Renderer *sr)
 {
     GLuint programs[COUNT_SIMPLE_SHADERS];
-    GLuint shaders[2] = {0};
+    GLuint glyphs_programs[COUNT_SIMPLE_SHADERS];
 
-    bool ok = true;
-
-    if (!compile_shader_file(vert_shader_file_path, GL_VERTEX_SHADER, &shaders[0])) {
-        ok = false;
-    }
-
-    for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i) {
-        if (!compile_shader_file(frag_shader_file_paths[i], GL_FRAGMENT_SHADER, &shaders[1])) {
-            ok = false;
-        }
-        programs[i] = glCreateProgram();
-        attach_shaders_to_program(shaders, sizeof(shaders) / sizeof(shaders[0]), programs[i]);
-        if (!link_program(programs[i], __FILE__, __LINE__)) {
-            ok = false;
-        }
-        glDeleteShader(shaders[1]);
-    }
-    glDeleteShader(shaders[0]);
+    bool ok = link_programs(vert_shader_file_path, programs);
+    ok = link_programs(glyph_vert_shader_file_path, glyphs_programs) && ok;
 
     if (ok) {
         for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i) {
             glDeleteProgram(sr->programs[i]);
             sr->programs[i] = programs[i];
+            glDeleteProgram(sr->glyphs_programs[i]);
+            sr->glyphs_programs[i] = glyphs_programs[i];
         }
         printf("Reloaded shaders successfully!\n");
     } else {
         for (int i = 0; i < COUNT_SIMPLE_SHADERS; ++i) {
             glDeleteProgram(programs[i]);
+            glDeleteProgram(glyphs_programs[i]);
         }
     }
 }
 
-// TODO: Don't render triples of verticies that form a triangle that is completely outside of the screen
-//
-// Ideas on how to check if a triangle is outside of the screen:
-// 1. Apply camera transformations to the triangle.
-// 2. Form an axis-aligned boundary box (AABB) of the triangle.
-// 3. Check if the Triangle AABB does not intersect the Screen AABB.
-//
-// This might not be what we want at the end of the day, though. Because in case of a lot of triangles we
-// end up iterating each of them at least once and doing camera trasformations on the CPU (which is
-// something we do on GPU already).
-//
-// It would be probably better if such culling occurred on a higher level of abstractions. For example
-// in the Editor. For instance, if the Editor noticed that the line it is currently rendering is
-// below the screen, it should stop rendering the rest of the text, thus never calling
-// simple_renderer_vertex() for a potentially large amount of verticies in the first place.
+// Maps the rest of the ring buffer after *begin for the next batch. Both the verticies and the glyphs go through these.
+static void *simple_renderer_map_ring(GLuint buffer, size_t item_size, size_t capacity, size_t *begin)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (*begin >= capacity) {
+        // NOTE: orphaning, the driver hands out new storage while the GPU may still draw from the old one
+        glBufferData(GL_ARRAY_BUFFER, capacity*item_size, NULL, GL_STREAM_DRAW);
+        *begin = 0;
+    }
+    // NOTE: unsynchronized is fine because nothing that was already drawn is ever written over without orphaning
+    void *items = glMapBufferRange(
+                      GL_ARRAY_BUFFER,
+                      *begin*item_size,
+                      (capacity - *begin)*item_size,
+                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+    assert(items != NULL && "Could not map the vertex buffer");
+    return items;
+}
+
+static void simple_renderer_unmap_ring(GLuint buffer, size_t item_size, size_t count)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, count*item_size);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+static void simple_renderer_flush_glyphs(Simple_Renderer *sr);
+
+static uint8_t simple_renderer_unorm8(float x)
+{
+    if (x <= 0.0f) return 0;
+    if (x >= 1.0f) return UINT8_MAX;
+    return (uint8_t) (x*UINT8_MAX + 0.5f);
+}
+
+static uint16_t simple_renderer_unorm16(float x)
+{
+    if (x <= 0.0f) return 0;
+    if (x >= 1.0f) return UINT16_MAX;
+    return (uint16_t) (x*UINT16_MAX + 0.5f);
+}
+
+static void simple_renderer_pack_color(uint8_t packed[4], Vec4f c)
+{
+    packed[0] = simple_renderer_unorm8(c.x);
+    packed[1] = simple_renderer_unorm8(c.y);
+    packed[2] = simple_renderer_unorm8(c.z);
+    packed[3] = simple_renderer_unorm8(c.w);
+}
+
 void simple_renderer_vertex(Simple_Renderer *sr, Vec2f p, Vec4f c, Vec2f uv)
 {
-#if 0
-    // TODO: flush the renderer on vertex buffer overflow instead firing the assert
-    if (sr->verticies_count >= SIMPLE_VERTICIES_CAP) simple_renderer_flush(sr);
-#else
-    // NOTE: it is better to just crash the app in this case until the culling described
-    // above is sorted out.
-    assert(sr->verticies_count < SIMPLE_VERTICIES_CAP);
-#endif
+    // NOTE: the batches begin and end on whole triangles and the capacity is divisible by 3,
+    // so a full buffer never cuts a triangle in half
+    if (sr->verticies_begin + sr->verticies_count >= SIMPLE_VERTICIES_CAP) simple_renderer_flush(sr);
+    // NOTE: the glyphs that came before have to be drawn before this, or they would end up on top
+    if (sr->glyphs_count > 0) simple_renderer_flush_glyphs(sr);
+    if (sr->verticies == NULL) {
+        sr->verticies = simple_renderer_map_ring(sr->vbo, sizeof(Simple_Vertex), SIMPLE_VERTICIES_CAP, &sr->verticies_begin);
+    }
+
     Simple_Vertex *last = &sr->verticies[sr->verticies_count];
     last->position = p;
-    last->color    = c;
-    last->uv       = uv;
+    simple_renderer_pack_color(last->color, c);
+    last->uv[0]    = simple_renderer_unorm16(uv.x);
+    last->uv[1]    = simple_renderer_unorm16(uv.y);
     sr->verticies_count += 1;
 }
 
@@ -301,33 +365,116 @@ void simple_renderer_solid_rect(Simple_Renderer *sr, Vec2f p, Vec2f s, Vec4f c)
         uv, uv, uv, uv);
 }
 
+void simple_renderer_glyph(Simple_Renderer *sr, Vec2f p, uint32_t glyph, Vec4f c)
+{
+    if (sr->glyphs_begin + sr->glyphs_count >= SIMPLE_GLYPHS_CAP) simple_renderer_flush_glyphs(sr);
+    if (sr->verticies_count > 0) simple_renderer_flush(sr);
+    if (sr->glyphs == NULL) {
+        sr->glyphs = simple_renderer_map_ring(sr->glyphs_vbo, sizeof(Simple_Glyph), SIMPLE_GLYPHS_CAP, &sr->glyphs_begin);
+    }
+
+    Simple_Glyph *last = &sr->glyphs[sr->glyphs_count];
+    last->position = p;
+    simple_renderer_pack_color(last->color, c);
+    last->glyph = glyph;
+    sr->glyphs_count += 1;
+}
+
 void simple_renderer_sync(Simple_Renderer *sr)
 {
-    glBufferSubData(GL_ARRAY_BUFFER,
-                    0,
-                    sr->verticies_count * sizeof(Simple_Vertex),
-                    sr->verticies);
+    if (sr->verticies == NULL) return;
+    simple_renderer_unmap_ring(sr->vbo, sizeof(Simple_Vertex), sr->verticies_count);
+    sr->verticies = NULL;
 }
 
 void simple_renderer_draw(Simple_Renderer *sr)
 {
-    glDrawArrays(GL_TRIANGLES, 0, sr->verticies_count);
+    glDrawArrays(GL_TRIANGLES, sr->verticies_begin, sr->verticies_count);
 }
 
-void simple_renderer_set_shader(Simple_Renderer *sr, Simple_Shader shader)
+static void simple_renderer_draw_glyphs(Simple_Renderer *sr)
 {
-    sr->current_shader = shader;
+    glBindVertexArray(sr->glyphs_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, sr->glyphs_vbo);
+    // NOTE: GL 3.3 has no base instance, so the batch is found by pointing the attributes at it
+    size_t offset = sr->glyphs_begin*sizeof(Simple_Glyph);
+    glVertexAttribPointer(
+        SIMPLE_GLYPH_ATTR_POSITION,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(Simple_Glyph),
+        (GLvoid *) (offset + offsetof(Simple_Glyph, position)));
+    glVertexAttribPointer(
+        SIMPLE_GLYPH_ATTR_COLOR,
+        4,
+        GL_UNSIGNED_BYTE,
+        GL_TRUE,
+        sizeof(Simple_Glyph),
+        (GLvoid *) (offset + offsetof(Simple_Glyph, color)));
+    glVertexAttribIPointer(
+        SIMPLE_GLYPH_ATTR_GLYPH,
+        1,
+        GL_UNSIGNED_INT,
+        sizeof(Simple_Glyph),
+        (GLvoid *) (offset + offsetof(Simple_Glyph, glyph)));
+
+    glUseProgram(sr->glyphs_programs[sr->current_shader]);
+    // The quad of every glyph is made up from gl_VertexID
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, sr->glyphs_count);
     glUseProgram(sr->programs[sr->current_shader]);
-    get_uniform_location(sr->programs[sr->current_shader], sr->uniforms);
+    glBindVertexArray(sr->vao);
+}
+
+static void simple_renderer_flush_glyphs(Simple_Renderer *sr)
+{
+    if (sr->glyphs != NULL) {
+        simple_renderer_unmap_ring(sr->glyphs_vbo, sizeof(Simple_Glyph), sr->glyphs_count);
+        sr->glyphs = NULL;
+    }
+    if (sr->glyphs_count > 0) {
+        simple_renderer_draw_glyphs(sr);
+        sr->glyphs_begin += sr->glyphs_count;
+    }
+    sr->glyphs_count = 0;
+}
+
+// The uniforms of the program that is in use
+static void simple_renderer_set_uniforms(Simple_Renderer *sr, GLuint program)
+{
+    get_uniform_location(program, sr->uniforms);
     glUniform2f(sr->uniforms[UNIFORM_SLOT_RESOLUTION], sr->resolution.x, sr->resolution.y);
     glUniform1f(sr->uniforms[UNIFORM_SLOT_TIME], sr->time);
     glUniform2f(sr->uniforms[UNIFORM_SLOT_CAMERA_POS], sr->camera_pos.x, sr->camera_pos.y);
     glUniform1f(sr->uniforms[UNIFORM_SLOT_CAMERA_SCALE], sr->camera_scale);
 }
 
+void simple_renderer_set_shader(Simple_Renderer *sr, Simple_Shader shader)
+{
+    sr->current_shader = shader;
+    glUseProgram(sr->glyphs_programs[sr->current_shader]);
+    simple_renderer_set_uniforms(sr, sr->glyphs_programs[sr->current_shader]);
+    glUseProgram(sr->programs[sr->current_shader]);
+    simple_renderer_set_uniforms(sr, sr->programs[sr->current_shader]);
+}
+
 void simple_renderer_flush(Simple_Renderer *sr)
 {
+    simple_renderer_flush_glyphs(sr);
     simple_renderer_sync(sr);
-    simple_renderer_draw(sr);
+    if (sr->verticies_count > 0) {
+        simple_renderer_draw(sr);
+        sr->verticies_begin += sr->verticies_count;
+    }
     sr->verticies_count = 0;
 }
+
+void simple_renderer_visible_rows(const Simple_Renderer *sr, size_t count, float line_height, size_t *begin, size_t *end)
+{
+    float half_height = sr->resolution.y/2.0f/sr->camera_scale;
+    float top = (-sr->camera_pos.y - half_height)/line_height;
+    float bottom = (-sr->camera_pos.y + half_height)/line_height + 2.0f;
+    float rows = (float) count;
+    *begin = top <= 0.0f ? 0 : top >= rows ? count : (size_t) top;
+    *end = bottom <= 0.0f ? 0 : bottom >= rows ? count : (size_t) bottom;
+}
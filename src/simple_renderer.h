@@ -2,6 +2,7 @@
 #define SIMPLE_RENDERER_H_
 
 #include <assert.h>
+#include <stdint.h>
 
 #include <GL/glew.h>
 
@@ -24,16 +25,43 @@ typedef enum {
     SIMPLE_VERTEX_ATTR_UV,
 } Simple_Vertex_Attr;
 
+// NOTE: the color and the uv are normalized integers, the shaders get them as floats in [0, 1]
 typedef struct {
     Vec2f position;
-    Vec4f color;
-    Vec2f uv;
+    uint8_t color[4];   // RGBA
+    uint16_t uv[2];
 } Simple_Vertex;
 
-#define SIMPLE_VERTICIES_CAP (3*640*1000)
+static_assert(sizeof(Simple_Vertex) == 16, "Simple_Vertex is meant to stay packed");
+
+typedef enum {
+    SIMPLE_GLYPH_ATTR_POSITION = 0,
+    SIMPLE_GLYPH_ATTR_COLOR,
+    SIMPLE_GLYPH_ATTR_GLYPH,
+} Simple_Glyph_Attr;
+
+// One instance of the quad in shaders/simple_glyph.vert. The size and the place of the glyph in
+// the atlas are looked up by its index in the uniform block that the atlas fills in.
+typedef struct {
+    Vec2f position;     // of the pen on the baseline
+    uint8_t color[4];   // RGBA
+    uint32_t glyph;
+} Simple_Glyph;
+
+static_assert(sizeof(Simple_Glyph) == 16, "The glyphs are meant to stay small, that's the whole point of them");
+
+// The binding point of the uniform block with the glyph metrics
+#define SIMPLE_GLYPHS_BINDING 0
+
+// The size of the vertex buffer in verticies. The batches are streamed through it, so it
+// only needs to be big enough to not wrap around too often within a frame (1.5 MB).
+#define SIMPLE_VERTICIES_CAP (3*32*1024)
 
 static_assert(SIMPLE_VERTICIES_CAP%3 == 0, "Simple renderer vertex capacity must be divisible by 3. We are rendring triangles after all.");
 
+// The size of the glyph buffer in glyphs (1 MB)
+#define SIMPLE_GLYPHS_CAP (64*1024)
+
 typedef enum {
     SHADER_FOR_COLOR = 0,
     SHADER_FOR_IMAGE,
@@ -48,8 +76,20 @@ typedef struct {
     GLuint programs[COUNT_SIMPLE_SHADERS];
     Simple_Shader current_shader;
 
+    // The text is drawn with instancing, a glyph per instance, by the same fragment shaders
+    GLuint glyphs_vao;
+    GLuint glyphs_vbo;
+    GLuint glyphs_programs[COUNT_SIMPLE_SHADERS];
+    Simple_Glyph *glyphs;       // mapped like verticies
+    size_t glyphs_begin;
+    size_t glyphs_count;
+
     GLint uniforms[COUNT_UNIFORM_SLOTS];
-    Simple_Vertex verticies[SIMPLE_VERTICIES_CAP];
+    // NOTE: the verticies are written straight into the mapped vbo, which is used as a ring. Every
+    // batch goes right after the previous one, so the driver never waits for the GPU to be done
+    // with the earlier draws, and the buffer is only orphaned when the ring wraps around.
+    Simple_Vertex *verticies;   // the rest of vbo after verticies_begin while mapped, NULL otherwise
+    size_t verticies_begin;     // of the current batch in vbo
     size_t verticies_count;
 
     Vec2f resolution;
@@ -83,8 +123,12 @@ void simple_renderer_quad(Simple_Renderer *sr,
                           Vec2f uv0, Vec2f uv1, Vec2f uv2, Vec2f uv3);
 void simple_renderer_solid_rect(Simple_Renderer *sr, Vec2f p, Vec2f s, Vec4f c);
 void simple_renderer_image_rect(Simple_Renderer *sr, Vec2f p, Vec2f s, Vec2f uvp, Vec2f uvs, Vec4f c);
+void simple_renderer_glyph(Simple_Renderer *sr, Vec2f p, uint32_t glyph, Vec4f c);
 void simple_renderer_flush(Simple_Renderer *sr);
 void simple_renderer_sync(Simple_Renderer *sr);
 void simple_renderer_draw(Simple_Renderer *sr);
+// The rows [*begin, *end) out of count that the camera can see, where row i is laid out
+// line_height tall from y = -i*line_height down
+void simple_renderer_visible_rows(const Simple_Renderer *sr, size_t count, float line_height, size_t *begin, size_t *end);
 
 #endif  // SIMPLE_RENDERER_H_
@@ -0,0 +1,94 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./tokens.h"
+
+void tokens_reserve(Tokens *tokens, size_t capacity)
+{
+    if (capacity <= tokens->capacity) return;
+
+    size_t new_capacity = tokens->capacity == 0 ? 256 : tokens->capacity;
+    while (capacity > new_capacity) new_capacity *= 2;
+
+    tokens->begins = realloc(tokens->begins, new_capacity*sizeof(*tokens->begins));
+    tokens->lens = realloc(tokens->lens, new_capacity*sizeof(*tokens->lens));
+    tokens->kinds = realloc(tokens->kinds, new_capacity*sizeof(*tokens->kinds));
+    assert(tokens->begins != NULL && tokens->lens != NULL && tokens->kinds != NULL && "Buy more RAM lol");
+    tokens->capacity = new_capacity;
+}
+
+void tokens_append(Tokens *tokens, Token token)
+{
+    do {
+        size_t len = token.text_len < UINT32_MAX ? token.text_len : UINT32_MAX;
+        tokens_reserve(tokens, tokens->count + 1);
+        tokens->begins[tokens->count] = token.begin;
+        tokens->lens[tokens->count] = (uint32_t) len;
+        tokens->kinds[tokens->count] = (uint8_t) token.kind;
+        tokens->count += 1;
+        token.begin += len;
+        token.text_len -= len;
+    } while (token.text_len > 0);
+}
+
+void tokens_replace(Tokens *tokens, size_t begin, size_t end, const Tokens *src)
+{
+    assert(begin <= end && end <= tokens->count);
+    size_t count = tokens->count - (end - begin) + src->count;
+    size_t tail = tokens->count - end;
+    tokens_reserve(tokens, count);
+
+#define TOKENS_REPLACE_FIELD(field)                                                                        \
+    do {                                                                                                   \
+        if (tail > 0) {                                                                                    \
+            memmove(&tokens->field[begin + src->count], &tokens->field[end], tail*sizeof(*tokens->field)); \
+        }                                                                                                  \
+        if (src->count > 0) {                                                                              \
+            memcpy(&tokens->field[begin], src->field, src->count*sizeof(*tokens->field));                  \
+        }                                                                                                  \
+    } while (0)
+    TOKENS_REPLACE_FIELD(begins);
+    TOKENS_REPLACE_FIELD(lens);
+    TOKENS_REPLACE_FIELD(kinds);
+#undef TOKENS_REPLACE_FIELD
+
+    tokens->count = count;
+}
+
+void tokens_shift(Tokens *tokens, size_t index, ptrdiff_t delta)
+{
+    for (size_t i = index; i < tokens->count; ++i) {
+        tokens->begins[i] += delta;
+    }
+}
+
+size_t tokens_lower_bound(const Tokens *tokens, size_t pos)
+{
+    size_t lo = 0;
+    size_t hi = tokens->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (tokens->begins[mid] < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+size_t tokens_at_offset(const Tokens *tokens, size_t pos)
+{
+    size_t index = tokens_lower_bound(tokens, pos + 1);
+    if (index == 0) return tokens->count;
+    index -= 1;
+    if (pos - tokens->begins[index] >= tokens->lens[index]) return tokens->count;
+    return index;
+}
+
+void tokens_in_range(const Tokens *tokens, size_t begin, size_t end, size_t *from, size_t *to)
+{
+    *from = tokens_lower_bound(tokens, begin);
+    if (*from > 0 && begin - tokens->begins[*from - 1] < tokens->lens[*from - 1]) *from -= 1;
+    *to = end > begin ? tokens_lower_bound(tokens, end) : *from;
+}
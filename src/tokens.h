@@ -0,0 +1,40 @@
+#ifndef TOKENS_H_
+#define TOKENS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "./lexer.h"
+
+// The tokens of a Buffer in ascending order, stored as separate arrays so a token
+// takes 13 bytes. Tokens longer than UINT32_MAX are stored as several pieces.
+typedef struct {
+    size_t *begins;
+    uint32_t *lens;
+    uint8_t *kinds;
+    size_t count;
+    size_t capacity;
+} Tokens;
+
+static inline Token tokens_at(const Tokens *tokens, size_t index)
+{
+    return (Token) {
+        .kind = tokens->kinds[index],
+        .begin = tokens->begins[index],
+        .text_len = tokens->lens[index],
+    };
+}
+
+void tokens_reserve(Tokens *tokens, size_t capacity);
+void tokens_append(Tokens *tokens, Token token);
+// Replaces the tokens [begin, end) with all the tokens of src.
+void tokens_replace(Tokens *tokens, size_t begin, size_t end, const Tokens *src);
+// Moves the tokens from index on by delta bytes.
+void tokens_shift(Tokens *tokens, size_t index, ptrdiff_t delta);
+// Index of the first token that begins at or after pos, O(log n)
+size_t tokens_lower_bound(const Tokens *tokens, size_t pos);
+// Index of the token that contains pos, or tokens->count if pos is not inside of any, O(log n)
+size_t tokens_at_offset(const Tokens *tokens, size_t pos);
+// The tokens [*from, *to) that overlap the bytes [begin, end), O(log n)
+void tokens_in_range(const Tokens *tokens, size_t begin, size_t end, size_t *from, size_t *to);
+
+#endif // TOKENS_H_